@@ -1,7 +1,11 @@
+#include <algorithm>
+#include <ctime>
 #include <fstream>
 #include <iostream>
 #include <limits>
 #include <iomanip>
+#include <map>
+#include <mutex>
 
 #ifdef __linux__ 
 #include <SDL2/SDL.h>  
@@ -12,6 +16,7 @@
 #endif
 
 #include "chip8.hpp"
+#include "profiler.hpp"
 
 const unsigned int PROGRAM_MEMORY_START_ADDRESS = 0x200; //The program gets loaded in to memory starting at this address (int 512).
 const unsigned int FONT_MEMORY_START_ADDRESS = 0x50; //Start of the font sprites address
@@ -39,9 +44,138 @@ u8 font[FONT_SIZE] =
 		0xF0, 0x80, 0xF0, 0x80, 0x80  // F
 	};
 
-/*	Set to zero the following: memory, V_registers, index register, stack, timers (delay and sound).
+/*	The image every Chip8 starts with: zeroed memory with the font loaded at 0x50 (this seems to be the convention commonly implemented.)
+	Built once and shared.	*/
+static std::shared_ptr<Rom_image const> blank_rom_image()
+{
+	static std::shared_ptr<Rom_image const> const image = []()
+	{
+		auto blank = std::make_shared<Rom_image>();
+		std::copy_n(font, FONT_SIZE, blank->memory + FONT_MEMORY_START_ADDRESS);
+		return blank;
+	}();
+	return image;
+}
+
+/*	Returns the image for a rom with these contents, shared with every other Chip8 that has loaded the same bytes and still
+	uses them, whatever file they came from. Keyed by contents rather than by path, so a rom edited on disk is never stale.
+	Images are held weakly and freed with their last user. The lock is for chip8_env, which can load from several threads.	*/
+std::shared_ptr<Rom_image const> Chip8::shared_rom_image(std::string const& contents)
+{
+	static std::mutex lock;
+	static std::map<std::string, std::weak_ptr<Rom_image const>> images;
+	std::lock_guard<std::mutex> guard(lock);
+
+	if (std::shared_ptr<Rom_image const> image = images[contents].lock())
+		return image;
+
+	for (auto entry = images.begin(); entry != images.end();)
+		entry = entry->second.expired() && entry->first != contents ? images.erase(entry) : std::next(entry);
+
+	// Build a new image from the font and the rom, starting at (0x200), and find its fused groups.
+	auto image = std::make_shared<Rom_image>(*blank_rom_image());
+	std::copy(contents.begin(), contents.end(), image->memory + PROGRAM_MEMORY_START_ADDRESS);
+	memory.load(image);
+	for (unsigned int address = 0; address < MEMORY_SIZE; ++address)
+		image->fused_groups[address] = match_fused_group_in_page(address);
+	images[contents] = image;
+	return image;
+}
+
+Paged_memory::Paged_memory()
+{
+	load(blank_rom_image());
+}
+
+Paged_memory::Paged_memory(Paged_memory const& other)
+{
+	*this = other;
+}
+
+/*	Shares the other's image and copies its private pages, reusing this one's private pages where both have one.	*/
+Paged_memory& Paged_memory::operator=(Paged_memory const& other)
+{
+	if (this == &other)
+		return *this;
+
+	rom = other.rom;
+	for (unsigned int page = 0; page < MEMORY_PAGE_COUNT; ++page)
+	{
+		if (!other.private_pages[page])
+			drop_page(page);
+		else
+			*take_page(page) = *other.private_pages[page];
+	}
+	point_pages();
+	return *this;
+}
+
+/*	Moves a private page to the spares, so the page is read from the image again.	*/
+void Paged_memory::drop_page(unsigned int page)
+{
+	if (private_pages[page])
+		spare_pages[spare_page_count++] = std::move(private_pages[page]);
+}
+
+/*	Returns the private page for page, taking a spare (or, failing that, allocating one) if it has none. Its contents are left as they were.	*/
+Private_page* Paged_memory::take_page(unsigned int page)
+{
+	if (!private_pages[page])
+	{
+		if (spare_page_count)
+			private_pages[page] = std::move(spare_pages[--spare_page_count]);
+		else
+			private_pages[page].reset(new Private_page);
+	}
+	return private_pages[page].get();
+}
+
+void Paged_memory::point_pages()
+{
+	unwritten_rom = rom.get();
+	for (unsigned int page = 0; page < MEMORY_PAGE_COUNT; ++page)
+	{
+		Private_page const* private_page = private_pages[page].get();
+		memory_pages[page] = private_page ? private_page->memory : rom->memory + page * MEMORY_PAGE_SIZE;
+		fused_group_pages[page] = private_page ? private_page->fused_groups : rom->fused_groups + page * MEMORY_PAGE_SIZE;
+		if (private_page)
+			unwritten_rom = nullptr;
+	}
+}
+
+/*	The first write to a page copies it (and its fused groups) out of the image.	*/
+void Paged_memory::write(u16 address, u8 value)
+{
+	address &= MEMORY_SIZE - 1;
+	unsigned int page = address / MEMORY_PAGE_SIZE;
+	if (!private_pages[page])
+	{
+		Private_page* private_page = take_page(page);
+		std::copy_n(rom->memory + page * MEMORY_PAGE_SIZE, MEMORY_PAGE_SIZE, private_page->memory);
+		std::copy_n(rom->fused_groups + page * MEMORY_PAGE_SIZE, MEMORY_PAGE_SIZE, private_page->fused_groups);
+		point_pages();
+	}
+	private_pages[page]->memory[address % MEMORY_PAGE_SIZE] = value;
+}
+
+void Paged_memory::set_fused_group(u16 address, u8 group)
+{
+	address &= MEMORY_SIZE - 1;
+	if (private_pages[address / MEMORY_PAGE_SIZE])
+		private_pages[address / MEMORY_PAGE_SIZE]->fused_groups[address % MEMORY_PAGE_SIZE] = group;
+}
+
+void Paged_memory::load(std::shared_ptr<Rom_image const> image)
+{
+	rom = std::move(image);
+	for (unsigned int page = 0; page < MEMORY_PAGE_COUNT; ++page)
+		drop_page(page);
+	point_pages();
+}
+
+/*	Set to zero the following: V_registers, index register, timers (delay and sound).
   	Set the program counter to 0x200 (512). The first 0x200 bits of memory are for backwards compatibility with older roms.
-  	Load font in to memory starting at location 0x50 (this seems to be the convention commonly implemented.)	*/	
+  	Memory goes back to the shared blank image, which is zeroed apart from the font at 0x50, and any private pages are dropped.	*/	
 void Chip8::clear_all()
 {
 	index_register = 0;
@@ -50,16 +184,12 @@ void Chip8::clear_all()
 
 	program_counter = PROGRAM_MEMORY_START_ADDRESS; //Sets the program counter to starting address (default 0x200).	
 		
-	for (unsigned int i = 0; i < MEMORY_SIZE; ++i) 	
-		memory[i] = 0;  // clear memory	
-	
-	for (unsigned int i = 0; i < FONT_SIZE; ++i)
-		memory[FONT_MEMORY_START_ADDRESS + i] = font[i]; //load font in to memory starting (0x50).
+	memory.load(blank_rom_image());
 	
 	for (unsigned int i =0; i < REGISTERS_COUNT; ++i)
 		V_registers[i] = 0; //clear V registers		
 
-	std::srand( ( u8 )std::time( nullptr ) );
+	seed_random( ( u32 )std::time( nullptr ) );
 		
 	cout << "Chip8 has been initialised.\n"; 
 }
@@ -83,16 +213,11 @@ bool Chip8::load_file(std::string const& file_name)
 		//Load file in to buffer if it fits in to memory.
 		if (file_size < MAX_FILE_SIZE)
 		{
-			char* buffer = new char[file_size];
-			file.read(buffer, file_size);	
-
-			// Load the file from the buffer in to memory, starting at (0x200).
-			for (int i = 0; i < file_size; ++i)
-			{
-				memory[i + PROGRAM_MEMORY_START_ADDRESS] = buffer[i];							
-			}
-			cout << file_name << " has been successfully loaded in to memory.\n";		
-			delete[] buffer;		
+			// Copies of this Chip8, and any other Chip8 that loads the same rom, share its image.
+			std::string contents(file_size, '\0');
+			file.read(&contents[0], file_size);
+			memory.load(shared_rom_image(contents));
+			cout << file_name << " has been successfully loaded in to memory.\n";
 		}
 		else 
 			{
@@ -113,179 +238,376 @@ bool Chip8::load_file(std::string const& file_name)
 
 
 /*	A single cycle will get the current op code, increase program counter by two to point to the next op code, 
-	interpret and execute the op code, and decrement the delay and sound timers. */
-void Chip8::cycle()
+	interpret and execute the op code, and decrement the delay and sound timers. 
+	If a fused group starts at the program counter, the whole group is run instead and the timers are decremented once for each instruction in it. */
+int Chip8::cycle()
 {		
-	
+	u8 group = memory.fused_group(program_counter);
+	if (group != NOT_FUSED && fusion_enabled)
+		return run_fused_group(group);
+
+	step();
+	return 1;
+}
+
+/*	Fetch, decode and execute the op code at the program counter, then decrement the timers.	*/
+void Chip8::step()
+{
+	if (profiler)
+		profiler->record(program_counter);
 	get_Op_Code();		
 	//cout << "Current Op code to be executed is: " << op_code << '\n';
 	program_counter += 2;		
 	decode_op_code();
-	
+	tick_timers(1);
+}
 
-	if (delay_timer > 0)	
-		--delay_timer;		
+/*	Seeds the random number generator used by Cxkk. A seed of 0 would get stuck at 0, so it is replaced.	*/
+void Chip8::seed_random(u32 seed)
+{
+	random_state = seed ? seed : 0x2545F491;
+}
 
-	if (sound_timer > 0)	
-		--sound_timer;	
+/*	xorshift32. Returns the top byte, which is the best mixed.	*/
+u8 Chip8::next_random()
+{
+	random_state ^= random_state << 13;
+	random_state ^= random_state >> 17;
+	random_state ^= random_state << 5;
+	return random_state >> 24;
+}
+
+/*	Decrement the delay and sound timers once for each instruction executed, stopping at 0.	*/
+void Chip8::tick_timers(u8 count)
+{
+	delay_timer = delay_timer > count ? delay_timer - count : 0;
+	sound_timer = sound_timer > count ? sound_timer - count : 0;
 }
 
 /* 	Gets two consecutive bytes starting from the program counter, and joins them together to get an op_code of length two bytes. */
 void Chip8::get_Op_Code()
 {				
-		op_code = (memory[program_counter] << 8) + memory[program_counter+1];
+		op_code = memory.read_op_code(program_counter);
 		//cout << "Opcode is " << std::hex << op_code << '\n';					
 }
 
-/*	Decodes the op code and then calls the corresponding function.	*/
-void Chip8::decode_op_code()
+/*	Reads the op code stored at any address without changing the program counter.	*/
+u16 Chip8::op_code_at(u16 address) const
 {
-	// Calculate Vx and Vy as they are always in the 2nd and 3rd byte positions (0xy0) of an opcode. If the opcode does not require a Vx or Vy value, it will not be used.
-	int Vx = (op_code & 0x0F00) >> 8;
-	int Vy = (op_code & 0x00F0) >> 4;
+	return memory.read_op_code(address);
+}
 
-	switch(op_code & 0xF000)
-	{	 
-		case (0x0000):
-			switch(op_code)
+/*	Peephole pass over memory that marks every address where a fused group starts. Every address is checked, not just even ones,
+	so a jump can land anywhere. A jump in to the middle of a group simply runs from that address as normal, since only the
+	first address of a group is marked. The rom image was already fused when it was loaded, so only private pages are redone.	*/
+void Chip8::fuse_program()
+{
+	fuse_range(0, MEMORY_SIZE - 1);
+}
+
+/*	Rechecks the addresses from first to last on private pages. Called after memory is written so that a group whose op codes were
+	changed stops being fused (or a new group starts being fused). Groups do not cross pages, so a write can only affect
+	groups on the pages it wrote to, which are private by then.	*/
+void Chip8::fuse_range(int first, int last)
+{
+	if (!fusion_enabled)
+		return;
+
+	for (int i = first; i <= last; ++i)
+	{
+		u16 address = i & (MEMORY_SIZE - 1); // Writes wrap around the end of memory, so the range does too.
+		if (memory.is_private(address))
+			memory.set_fused_group(address, match_fused_group_in_page(address));
+	}
+}
+
+/*	Attaching a profiler turns fusion off so that every instruction is counted at its own address. Pass nullptr to detach.	*/
+void Chip8::attach_profiler(Profiler* new_profiler)
+{
+	profiler = new_profiler;
+	set_fusion(profiler == nullptr);
+}
+
+void Chip8::set_fusion(bool enabled)
+{
+	fusion_enabled = enabled;
+	if (enabled)
+		fuse_program();
+}
+
+static unsigned int fused_group_length(Fused_group group)
+{
+	switch (group)
+	{
+		case (FUSED_SPRITE_DRAW): return 8;
+		case (FUSED_COUNTED_LOOP): return 6;
+		case (FUSED_TABLE_LOAD):
+		case (FUSED_TIMER_WAIT): return 4;
+		default: return 0;
+	}
+}
+
+/*	As match_fused_group, except that a group running past the end of its page is not fused.	*/
+Fused_group Chip8::match_fused_group_in_page(u16 address) const
+{
+	Fused_group group = match_fused_group(address);
+	if (address % MEMORY_PAGE_SIZE + fused_group_length(group) > MEMORY_PAGE_SIZE)
+		return NOT_FUSED;
+	return group;
+}
+
+/*	Returns the fused group that starts at address, or NOT_FUSED. None of the groups write to memory, 
+	so a group can never modify its own op codes while it runs. Groups that would run past the end of memory are not fused.	*/
+Fused_group Chip8::match_fused_group(u16 address) const
+{
+	unsigned int space = MEMORY_SIZE - (address & (MEMORY_SIZE - 1)); // Bytes from address to the end of memory.
+	if (space < 4)
+		return NOT_FUSED;
+
+	u16 first = op_code_at(address);
+	u16 second = op_code_at(address + 2);
+
+	if ((first & 0xF0FF) == 0xF015 && (second & 0xF0FF) == 0xF007)
+		return FUSED_TIMER_WAIT;
+	if ((first & 0xF0FF) == 0xF01E && (second & 0xF0FF) == 0xF065)
+		return FUSED_TABLE_LOAD;
+
+	if (space < 6)
+		return NOT_FUSED;
+
+	u16 third = op_code_at(address + 4);
+
+	if ((first & 0xF000) == 0x7000 && (second & 0xF000) == 0x3000 && (third & 0xF000) == 0x1000)
+		return FUSED_COUNTED_LOOP;
+
+	if (space < 8)
+		return NOT_FUSED;
+
+	u16 fourth = op_code_at(address + 6);
+
+	if ((first & 0xF000) == 0x6000 && (second & 0xF000) == 0x6000 && (third & 0xF000) == 0xA000 && (fourth & 0xF000) == 0xD000)
+		return FUSED_SPRITE_DRAW;
+
+	return NOT_FUSED;
+}
+
+/*	Runs the fused group at the program counter in one go and returns how many instructions it executed.
+	The result is the same as running each instruction through cycle(), including the timers being decremented after each one,
+	but the op codes are only fetched, not decoded. The timers are only read by Fy07, so everywhere else their decrements are batched.	*/
+int Chip8::run_fused_group(u8 group)
+{
+	u16 start = program_counter;
+	u16 first = op_code_at(start);
+	u16 second = op_code_at(start + 2);
+	u8 x = (first & 0x0F00) >> 8;
+	u8 y = (second & 0x0F00) >> 8;
+
+	switch (group)
+	{
+		case (FUSED_SPRITE_DRAW):
+		{
+			u16 third = op_code_at(start + 4);
+			op_code = op_code_at(start + 6);
+			V_registers[x] = first & 0x00FF;
+			V_registers[y] = second & 0x00FF;
+			index_register = third & 0x0FFF;
+			program_counter = start + 8;
+			Op_Code_Dxyn((op_code & 0x0F00) >> 8, (op_code & 0x00F0) >> 4);
+			tick_timers(4);
+			return 4;
+		}
+
+		case (FUSED_TABLE_LOAD):
+			op_code = second;
+			index_register += V_registers[x];
+			program_counter = start + 4;
+			Op_Code_Fx65(y);
+			tick_timers(2);
+			return 2;
+
+		case (FUSED_COUNTED_LOOP):
+			V_registers[x] += first & 0x00FF;
+			if (V_registers[y] == (second & 0x00FF))
 			{
-				case (0x00E0):	
-					Op_Code_00E0();					
-					break;
-				case (0x00EE):
-					Op_Code_00EE();
-					break;				
+				op_code = second;
+				program_counter = start + 6;
+				tick_timers(2);
+				return 2;
 			}
-			break;
-		case (0x1000):			
-			Op_Code_1nnn();
-			break;			
-		case (0x2000):
-			Op_Code_2nnn();
-			break;	
-		case (0x3000):
-			Op_Code_3xkk(Vx);
-			break;	
-		case (0x4000):			
-			Op_Code_4xkk(Vx);
-			break;	
-		case (0x5000):
-			Op_Code_5xy0(Vx, Vy);
-			break;						
-		case (0x6000):			
-			Op_Code_6xkk(Vx);
-			break;
-		case (0x7000):			
-			Op_Code_7xkk(Vx);
-			break;
+			op_code = op_code_at(start + 4);
+			program_counter = op_code & 0x0FFF;
+			tick_timers(3);
+			return 3;
+
+		case (FUSED_TIMER_WAIT):
+			op_code = second;
+			delay_timer = V_registers[x];
+			tick_timers(1);
+			V_registers[y] = delay_timer;
+			program_counter = start + 4;
+			tick_timers(1);
+			return 2;
+	}
+	return 0;
+}
+
+/*	Packs the display in to one bit per pixel, one u64 per row. The leftmost pixel of a row is stored in the most significant bit.	*/
+void Chip8::pack_display(u64* rows) const
+{
+	for (unsigned int y = 0; y < Y_RESOLUTION; ++y)
+	{
+		u64 row = 0;
+		for (unsigned int x = 0; x < X_RESOLUTION; ++x)
+			row = (row << 1) | (display_array[y * X_RESOLUTION + x] & 1);
+		rows[y] = row;
+	}
+}
+
+/*	Every op code handler, in the order of the labels in decode_op_code. OP_CODE_TRAP is for op codes that are not CHIP-8 instructions.	*/
+enum Op_code_handler : u8
+{
+	HANDLER_00E0, HANDLER_00EE, HANDLER_1nnn, HANDLER_2nnn, HANDLER_3xkk, HANDLER_4xkk, HANDLER_5xy0, HANDLER_6xkk, HANDLER_7xkk,
+	HANDLER_8xy0, HANDLER_8xy1, HANDLER_8xy2, HANDLER_8xy3, HANDLER_8xy4, HANDLER_8xy5, HANDLER_8xy6, HANDLER_8xy7, HANDLER_8xyE,
+	HANDLER_9xy0, HANDLER_Annn, HANDLER_Bnnn, HANDLER_Cxkk, HANDLER_Dxyn, HANDLER_Ex9E, HANDLER_ExA1,
+	HANDLER_Fx07, HANDLER_Fx0A, HANDLER_Fx15, HANDLER_Fx18, HANDLER_Fx1E, HANDLER_Fx29, HANDLER_Fx33, HANDLER_Fx55, HANDLER_Fx65,
+	OP_CODE_TRAP
+};
+
+/*	Works out which handler an op code belongs to. This is the same decoding the interpreter used to do with nested switches on 
+	every instruction, but it now only runs at compile time to fill in op_code_handlers.	*/
+constexpr Op_code_handler classify_op_code(u16 op_code)
+{
+	switch (op_code & 0xF000)
+	{
+		case (0x0000):
+			if (op_code == 0x00E0) return HANDLER_00E0;
+			if (op_code == 0x00EE) return HANDLER_00EE;
+			return OP_CODE_TRAP;
+		case (0x1000): return HANDLER_1nnn;
+		case (0x2000): return HANDLER_2nnn;
+		case (0x3000): return HANDLER_3xkk;
+		case (0x4000): return HANDLER_4xkk;
+		case (0x5000): return HANDLER_5xy0;
+		case (0x6000): return HANDLER_6xkk;
+		case (0x7000): return HANDLER_7xkk;
 		case (0x8000):
-			switch(op_code & 0x000F)
+			switch (op_code & 0x000F)
 			{
-				case(0x0000):
-					Op_Code_8xy0(Vx, Vy);
-					break;
-				case(0x0001):
-					Op_Code_8xy1(Vx, Vy);
-					break;
-				case(0x0002):
-					Op_Code_8xy2(Vx, Vy);
-					break;
-				case(0x0003):
-					Op_Code_8xy3(Vx, Vy);
-					break;
-				case(0x0004):
-					Op_Code_8xy4(Vx, Vy);
-					break;
-				case(0x0005):
-					Op_Code_8xy5(Vx, Vy);
-					break;
-				case(0x0006):
-					Op_Code_8xy6(Vx, Vy);
-					break;
-				case(0x0007):
-					Op_Code_8xy7(Vx, Vy);
-					break;
-				case(0x000E):
-					Op_Code_8xyE(Vx, Vy);
-					break;			
+				case (0x0000): return HANDLER_8xy0;
+				case (0x0001): return HANDLER_8xy1;
+				case (0x0002): return HANDLER_8xy2;
+				case (0x0003): return HANDLER_8xy3;
+				case (0x0004): return HANDLER_8xy4;
+				case (0x0005): return HANDLER_8xy5;
+				case (0x0006): return HANDLER_8xy6;
+				case (0x0007): return HANDLER_8xy7;
+				case (0x000E): return HANDLER_8xyE;
 			}
-			break;
-		case(0x9000):
-			Op_Code_9xy0(Vx, Vy);
-			break;
-		
-		case (0xA000):
-			Op_Code_Annn();	
-			break;
-
-		case (0xB000):
-			Op_Code_Bnnn();
-			break;
-
-		case(0xC000):
-			Op_Code_Cxkk(Vx);
-			break;
-
-		case (0xD000):			
-			Op_Code_Dxyn(Vx, Vy);	
-			break;
-
-		case(0xE000):
-			switch(op_code & 0x00FF)
-			{	
-				case(0x009E):
-					Op_Code_Ex9E(Vx);
-					break;	
-
-				case(0x00A1):		
-					Op_Code_ExA1(Vx);
-					break;	
-			}
-			break;			
-		
-		case(0xF000):				
+			return OP_CODE_TRAP;
+		case (0x9000): return HANDLER_9xy0;
+		case (0xA000): return HANDLER_Annn;
+		case (0xB000): return HANDLER_Bnnn;
+		case (0xC000): return HANDLER_Cxkk;
+		case (0xD000): return HANDLER_Dxyn;
+		case (0xE000):
+			if ((op_code & 0x00FF) == 0x009E) return HANDLER_Ex9E;
+			if ((op_code & 0x00FF) == 0x00A1) return HANDLER_ExA1;
+			return OP_CODE_TRAP;
+		default:
 			switch (op_code & 0x00FF)
 			{
-				case (0x0007):
-					Op_Code_Fx07(Vx);
-					break;
-
-				case (0x000A):
-					Op_Code_Fx0A(Vx);
-					break;
-
-				case (0x0015):
-					Op_Code_Fx15(Vx);
-					break;
-
-				case (0x0018):
-					Op_Code_Fx18(Vx);
-					break;
-
-				case (0x001E):
-					Op_Code_Fx1E(Vx);
-					break;
-
-				case (0x0029):
-					Op_Code_Fx29(Vx);
-					break;
-
-				case (0x0033):
-					Op_Code_Fx33(Vx);
-					break;					
-				
-				case (0x0055):
-					Op_Code_Fx55(Vx);
-					break;	
-				
-				case (0x0065):
-					Op_Code_Fx65(Vx);
-					break;					
-			}	
-			break;
-		default:
-			throw std::runtime_error("Invalid Opcode found");				
-	}	
+				case (0x0007): return HANDLER_Fx07;
+				case (0x000A): return HANDLER_Fx0A;
+				case (0x0015): return HANDLER_Fx15;
+				case (0x0018): return HANDLER_Fx18;
+				case (0x001E): return HANDLER_Fx1E;
+				case (0x0029): return HANDLER_Fx29;
+				case (0x0033): return HANDLER_Fx33;
+				case (0x0055): return HANDLER_Fx55;
+				case (0x0065): return HANDLER_Fx65;
+			}
+			return OP_CODE_TRAP;
+	}
+}
+
+struct Op_code_table
+{
+	u8 handlers[0x10000];
+};
+
+constexpr Op_code_table make_op_code_table()
+{
+	Op_code_table table {};
+	for (u32 op_code = 0; op_code < 0x10000; ++op_code)
+		table.handlers[op_code] = classify_op_code(op_code);
+	return table;
+}
+
+// One byte for each of the 65536 possible op codes, generated at compile time.
+static constexpr Op_code_table op_code_handlers = make_op_code_table();
+
+/*	Decodes the op code and then calls the corresponding function. Decoding is a single lookup in op_code_handlers followed by
+	one indirect jump (a GCC/Clang computed goto) to the handler.	*/
+void Chip8::decode_op_code()
+{
+	static void* const handler_labels[] =
+	{
+		&&op_00E0, &&op_00EE, &&op_1nnn, &&op_2nnn, &&op_3xkk, &&op_4xkk, &&op_5xy0, &&op_6xkk, &&op_7xkk,
+		&&op_8xy0, &&op_8xy1, &&op_8xy2, &&op_8xy3, &&op_8xy4, &&op_8xy5, &&op_8xy6, &&op_8xy7, &&op_8xyE,
+		&&op_9xy0, &&op_Annn, &&op_Bnnn, &&op_Cxkk, &&op_Dxyn, &&op_Ex9E, &&op_ExA1,
+		&&op_Fx07, &&op_Fx0A, &&op_Fx15, &&op_Fx18, &&op_Fx1E, &&op_Fx29, &&op_Fx33, &&op_Fx55, &&op_Fx65,
+		&&op_trap
+	};
+
+	// Calculate Vx and Vy as they are always in the 2nd and 3rd byte positions (0xy0) of an opcode. If the opcode does not require a Vx or Vy value, it will not be used.
+	u8 Vx = (op_code & 0x0F00) >> 8;
+	u8 Vy = (op_code & 0x00F0) >> 4;
+
+	goto *handler_labels[op_code_handlers.handlers[op_code]];
+
+	op_00E0: Op_Code_00E0(); return;
+	op_00EE: Op_Code_00EE(); return;
+	op_1nnn: Op_Code_1nnn(); return;
+	op_2nnn: Op_Code_2nnn(); return;
+	op_3xkk: Op_Code_3xkk(Vx); return;
+	op_4xkk: Op_Code_4xkk(Vx); return;
+	op_5xy0: Op_Code_5xy0(Vx, Vy); return;
+	op_6xkk: Op_Code_6xkk(Vx); return;
+	op_7xkk: Op_Code_7xkk(Vx); return;
+	op_8xy0: Op_Code_8xy0(Vx, Vy); return;
+	op_8xy1: Op_Code_8xy1(Vx, Vy); return;
+	op_8xy2: Op_Code_8xy2(Vx, Vy); return;
+	op_8xy3: Op_Code_8xy3(Vx, Vy); return;
+	op_8xy4: Op_Code_8xy4(Vx, Vy); return;
+	op_8xy5: Op_Code_8xy5(Vx, Vy); return;
+	op_8xy6: Op_Code_8xy6(Vx, Vy); return;
+	op_8xy7: Op_Code_8xy7(Vx, Vy); return;
+	op_8xyE: Op_Code_8xyE(Vx, Vy); return;
+	op_9xy0: Op_Code_9xy0(Vx, Vy); return;
+	op_Annn: Op_Code_Annn(); return;
+	op_Bnnn: Op_Code_Bnnn(); return;
+	op_Cxkk: Op_Code_Cxkk(Vx); return;
+	op_Dxyn: Op_Code_Dxyn(Vx, Vy); return;
+	op_Ex9E: Op_Code_Ex9E(Vx); return;
+	op_ExA1: Op_Code_ExA1(Vx); return;
+	op_Fx07: Op_Code_Fx07(Vx); return;
+	op_Fx0A: Op_Code_Fx0A(Vx); return;
+	op_Fx15: Op_Code_Fx15(Vx); return;
+	op_Fx18: Op_Code_Fx18(Vx); return;
+	op_Fx1E: Op_Code_Fx1E(Vx); return;
+	op_Fx29: Op_Code_Fx29(Vx); return;
+	op_Fx33: Op_Code_Fx33(Vx); return;
+	op_Fx55: Op_Code_Fx55(Vx); return;
+	op_Fx65: Op_Code_Fx65(Vx); return;
+	op_trap: Op_Code_trap(); return;
+}
+
+/*	Any op code that is not a CHIP-8 instruction lands here. It is skipped, as it always has been, but counted so a frontend
+	or the corpus runner can report it.	*/
+void Chip8::Op_Code_trap()
+{
+	++trapped_op_code_count;
+	last_trapped_op_code = op_code;
 }
 
 /*	Clears the display by setting the display array to all 0.	*/
@@ -294,11 +616,14 @@ void Chip8::Op_Code_00E0()
 	std::fill_n (display_array, PIXEL_COUNT, 0);		
 }
 
-/*	Return from a subroutine. Sets program counter to the address at top of the stack.	*/
+/*	Return from a subroutine. Sets program counter to the address at top of the stack. The stack pointer wraps like it does
+	in 2nnn, so a return with nothing on the stack takes the address in the last entry.	*/
 void Chip8::Op_Code_00EE() 
 {	
-	--stack_pointer;
+	stack_pointer = (stack_pointer - 1) & (STACK_COUNT - 1);
 	program_counter = stack[stack_pointer];
+	if (profiler)
+		profiler->leave_subroutine();
 }
 
 /*	Jump to memory location nnn.	*/ 
@@ -307,12 +632,15 @@ void Chip8::Op_Code_1nnn()
 	program_counter = (op_code & 0x0FFF);
 }
 
-/*	Call subroutine at memory location nnn.	*/
+/*	Call subroutine at memory location nnn. The stack pointer wraps at STACK_COUNT, so calls nested deeper than that overwrite
+	the oldest return addresses instead of the members after the stack.	*/
 void Chip8::Op_Code_2nnn()
 {		
 	stack[stack_pointer] = program_counter;
-	++stack_pointer;
+	stack_pointer = (stack_pointer + 1) & (STACK_COUNT - 1);
 	program_counter = (op_code & 0x0FFF);
+	if (profiler)
+		profiler->enter_subroutine(program_counter);
 }
 
 /*	Skip next instruction if what is stored in V_Registers[x] is equal to kk.	*/
@@ -467,7 +795,7 @@ void Chip8::Op_Code_Cxkk(u8 Vx)
 {
 	u8 low_number  = 0;
     u8 high_number = 255;    
-	u8 random_number = low_number + std::rand() % ( high_number - low_number );			
+	u8 random_number = low_number + next_random() % ( high_number - low_number );			
 	V_registers[Vx] = (op_code & 0x00FF) & random_number;	
 	
 };
@@ -493,7 +821,7 @@ void Chip8::Op_Code_Dxyn(u8 Vx, u8 Vy)
 
 	for (int y_row = 0; y_row < sprite_height; ++y_row)
 	{
-		int sprite_data = memory[index_register + y_row];
+		int sprite_data = memory.read(index_register + y_row);
 		
 		for (int x_column = 0; x_column < 8; ++x_column)
 		{						
@@ -598,21 +926,23 @@ void Chip8::Op_Code_Fx29(u8 Vx)
 	the tens digit at location index_register +1, and the ones digit at location index_register+2 */
 void Chip8::Op_Code_Fx33(u8 Vx) 
 {	
-	memory[index_register] = V_registers[Vx] / 100;
-	memory[index_register + 1] = (V_registers[Vx]/10) % 10;	
-	memory[index_register + 2] = V_registers[Vx] % 10;  
+	memory.write(index_register, V_registers[Vx] / 100);
+	memory.write(index_register + 1, (V_registers[Vx]/10) % 10);	
+	memory.write(index_register + 2, V_registers[Vx] % 10);  
+	fuse_range(index_register - 7, index_register + 2);
 }
 
 /*	Copy the values of index_register through Vx in to memory, starting at the address in the index register	*/
 void Chip8::Op_Code_Fx55(u8 Vx) 
 {	
 	for (u8 i = 0; i <= Vx; ++i)	
-		memory[index_register + i] = V_registers[i];
+		memory.write(index_register + i, V_registers[i]);
+	fuse_range(index_register - 7, index_register + Vx);
 }
 
 /*	Read values from memory starting at location i into registers V0 through Vx	*/
 void Chip8::Op_Code_Fx65(u8 Vx) 
 {	
 	for (u8 i = 0; i <= Vx; ++i)	
-		V_registers[i] = memory[index_register + i];	
+		V_registers[i] = memory.read(index_register + i);	
 }
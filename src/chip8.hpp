@@ -8,6 +8,8 @@
 #include <SDL2/SDL.h>  
 #endif
 
+#include <memory>
+#include <string>
 
 const unsigned int MEMORY_SIZE = 4096;
 const unsigned int REGISTERS_COUNT = 16;
@@ -15,15 +17,98 @@ const unsigned int STACK_COUNT = 16;
 const unsigned int X_RESOLUTION = 64;
 const unsigned int Y_RESOLUTION = 32;
 const unsigned int KEY_COUNT = 16;
+const unsigned int MEMORY_PAGE_SIZE = 256;
+const unsigned int MEMORY_PAGE_COUNT = MEMORY_SIZE / MEMORY_PAGE_SIZE;
 
 using std::cout;
 using u8 = uint8_t;
 using u16 = uint16_t;
 using u32 = uint32_t; 
+using u64 = uint64_t;
+
+// Recurring op code sequences that are recognised when a program is loaded and then run by one handler instead of being decoded one at a time.
+enum Fused_group : u8
+{
+    NOT_FUSED,
+    FUSED_SPRITE_DRAW,  // 6xkk, 6ykk, Annn, Dxyn
+    FUSED_TABLE_LOAD,   // Fx1E, Fy65
+    FUSED_COUNTED_LOOP, // 7xkk, 3ykk, 1nnn
+    FUSED_TIMER_WAIT    // Fx15, Fy07
+};
+
+class Profiler;
+
+// Memory as a rom is loaded: the font and the program, with the fused groups found in them. Shared, read-only, by every Chip8 running that rom.
+struct Rom_image
+{
+    u8 memory[MEMORY_SIZE] {};
+    u8 fused_groups[MEMORY_SIZE] {};
+};
+
+// A page that one Chip8 has written to, and the fused groups in it.
+struct Private_page
+{
+    u8 memory[MEMORY_PAGE_SIZE];
+    u8 fused_groups[MEMORY_PAGE_SIZE];
+};
+
+/*	Copy-on-write memory. Every page is read from the shared Rom_image until the program writes to it (only Fx33 and Fx55 do),
+	at which point this instance gets a private copy of that page. Copying a Paged_memory shares the image and copies only the
+	private pages, and loading or resetting drops them, so many instances of one rom cost little more than one.
+	Dropped pages are kept as spares and reused by the next write or copy, so resetting an instance over and over
+	(e.g. every episode in chip8_env) allocates nothing once it has as many pages as it ever needs.
+	Until the first write, reads go straight to the image without the page table; most roms never write to their own pages.
+	Fused groups never cross a page boundary, so each page's groups can be taken from wherever that page is read from.	*/
+class Paged_memory
+{
+    private:
+        std::shared_ptr<Rom_image const> rom;
+        Rom_image const* unwritten_rom = nullptr; // The image while there are no private pages, otherwise nullptr.
+        std::unique_ptr<Private_page> private_pages[MEMORY_PAGE_COUNT];
+        std::unique_ptr<Private_page> spare_pages[MEMORY_PAGE_COUNT]; // Pages that were dropped, for reuse. Never copied.
+        unsigned int spare_page_count {};
+        u8 const* memory_pages[MEMORY_PAGE_COUNT] {}; // Where each page is read from, the image or a private page.
+        u8 const* fused_group_pages[MEMORY_PAGE_COUNT] {};
+
+        void point_pages();
+        void drop_page(unsigned int page);
+        Private_page* take_page(unsigned int page);
+
+    public:
+        Paged_memory();
+        Paged_memory(Paged_memory const& other);
+        Paged_memory& operator=(Paged_memory const& other);
+
+        // Addresses past the end of memory wrap around to the start.
+        u8 read(u16 address) const
+        {
+            address &= MEMORY_SIZE - 1;
+            if (unwritten_rom)
+                return unwritten_rom->memory[address];
+            return memory_pages[address / MEMORY_PAGE_SIZE][address % MEMORY_PAGE_SIZE];
+        }
+        u16 read_op_code(u16 address) const // Big-endian.
+        {
+            return (read(address) << 8) | read(address + 1);
+        }
+        u8 fused_group(u16 address) const
+        {
+            address &= MEMORY_SIZE - 1;
+            if (unwritten_rom)
+                return unwritten_rom->fused_groups[address];
+            return fused_group_pages[address / MEMORY_PAGE_SIZE][address % MEMORY_PAGE_SIZE];
+        }
+        void write(u16 address, u8 value);
+        void set_fused_group(u16 address, u8 group); // Only private pages can be changed. The image's groups are found when it is built.
+        bool is_private(u16 address) const { return private_pages[(address & (MEMORY_SIZE - 1)) / MEMORY_PAGE_SIZE] != nullptr; }
+        void load(std::shared_ptr<Rom_image const> image); // Drops every private page.
+};
+
+extern u8 font[]; // The hex digit sprites 0 to F, 5 bytes each. Defined in chip8.cpp.
 
 class Chip8 {
     private:           
-        u8 memory[MEMORY_SIZE] {};
+        Paged_memory memory;
         u8 V_registers[REGISTERS_COUNT] {};
         u16 index_register {};
         u16 stack[STACK_COUNT] {};
@@ -31,6 +116,19 @@ class Chip8 {
         u8 sound_timer {};       
         u16 program_counter {};
         u16 op_code {}; 
+        bool fusion_enabled = true;
+        u64 trapped_op_code_count {};
+        u16 last_trapped_op_code {};
+        Profiler* profiler = nullptr;
+        u32 random_state = 1; // xorshift32 state for Cxkk. Kept per instance so that seeded runs are reproducible, even across threads.
+
+        Fused_group match_fused_group(u16 address) const;
+        Fused_group match_fused_group_in_page(u16 address) const;
+        std::shared_ptr<Rom_image const> shared_rom_image(std::string const& contents); // Points memory at the image while its fused groups are found.
+        void fuse_range(int first, int last);
+        int run_fused_group(u8 group);
+        void tick_timers(u8 count);
+        u8 next_random();
         
         void Op_Code_00E0(); // ! Clear the display
         void Op_Code_00EE();
@@ -66,6 +164,7 @@ class Chip8 {
         void Op_Code_Fx33(u8 Vx); //Store BCD representation of Vx in memory locations I, I+1, I+2
         void Op_Code_Fx55(u8 Vx); //Store registers V0 through Vx in memory starting at location I
         void Op_Code_Fx65(u8 Vx); //Read registers V0 through Vx from memory starting at location I            
+        void Op_Code_trap(); //Not a CHIP-8 instruction. Counted and skipped.
             
     public:        
         Chip8() = default;      
@@ -76,6 +175,22 @@ class Chip8 {
         void clear_all();   
         void get_Op_Code();    
         void decode_op_code();     
-        void cycle();
+        int cycle(); // Returns the number of instructions executed, which is more than one when a fused group ran.
+        void step(); // Executes exactly one instruction, never a fused group.
+        void seed_random(u32 seed);
+        u16 get_program_counter() const { return program_counter; }
+        u16 get_index_register() const { return index_register; }
+        u8 const* get_V_registers() const { return V_registers; }
+        u8 get_sound_timer() const { return sound_timer; }
+        u8 get_stack_pointer() const { return stack_pointer; }
+        u64 get_trapped_op_code_count() const { return trapped_op_code_count; }
+        u16 get_last_trapped_op_code() const { return last_trapped_op_code; }
+        u16 op_code_at(u16 address) const;
+        u8 read_memory(u16 address) const { return memory.read(address); }
+        void fuse_program();
+        void set_fusion(bool enabled);
+        void attach_profiler(Profiler* new_profiler);
+        void detach_profiler() { profiler = nullptr; } // Stops counting without re-fusing the program, for throwaway copies of a profiled machine.
+        void pack_display(u64* rows) const; // One u64 per display row, leftmost pixel in the most significant bit
         
 };
\ No newline at end of file
@@ -0,0 +1,285 @@
+#include <algorithm>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "chip8.hpp"
+#include "chip8_env.h"
+
+const int DEFAULT_INSTRUCTIONS_PER_FRAME = 12;
+const unsigned int MAX_REWARD_ADDRESSES = 8;
+
+struct Chip8_env
+{
+	Chip8 initial; // The machine straight after the rom was loaded. Every reset is a copy of it, which shares its rom image and keeps any private pages as spares for the next episode.
+	std::vector<Chip8> machines;
+	std::vector<u32> seeds;
+	std::vector<u64> scores;
+	std::vector<u32> episode_frames;
+	std::vector<int> instructions_owed;
+	std::vector<u8> needs_reset;
+
+	int instructions_per_frame = DEFAULT_INSTRUCTIONS_PER_FRAME;
+	u16 reward_addresses[MAX_REWARD_ADDRESSES] {};
+	int reward_address_count = 0;
+	bool reward_bcd = false;
+	int done_address = -1;
+	u8 done_value = 0;
+	u32 episode_frame_limit = 0;
+
+	// Arguments of the step in progress, read by every worker.
+	const uint16_t* actions = nullptr;
+	int frames_per_step = 0;
+	void* observations = nullptr;
+	int observation_format = 0;
+	float* rewards = nullptr;
+	uint8_t* dones = nullptr;
+
+	// Thread pool. Worker i runs its own fixed slice of the environments; the calling thread runs slice 0.
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable step_ready;
+	std::condition_variable step_finished;
+	u64 step_generation = 0;
+	int workers_running = 0;
+	bool stopping = false;
+};
+
+static u64 read_score(Chip8_env const& env, Chip8 const& chip8)
+{
+	u64 score = 0;
+	for (int i = 0; i < env.reward_address_count; ++i)
+		score = score * (env.reward_bcd ? 10 : 256) + chip8.read_memory(env.reward_addresses[i]);
+	return score;
+}
+
+static void reset_machine(Chip8_env& env, int index)
+{
+	env.machines[index] = env.initial;
+	env.machines[index].seed_random(env.seeds[index]);
+	env.scores[index] = read_score(env, env.machines[index]);
+	env.episode_frames[index] = 0;
+	env.instructions_owed[index] = 0;
+	env.needs_reset[index] = 0;
+}
+
+static bool is_done(Chip8_env const& env, int index)
+{
+	Chip8 const& chip8 = env.machines[index];
+	u16 program_counter = chip8.get_program_counter();
+
+	if (env.done_address >= 0 && chip8.read_memory(env.done_address) == env.done_value)
+		return true;
+	if (chip8.op_code_at(program_counter) == (0x1000 | program_counter))
+		return true;
+	return env.episode_frame_limit && env.episode_frames[index] >= env.episode_frame_limit;
+}
+
+/*	Runs one step of the environments from first up to (not including) last. Each environment only touches its own slot
+	in the caller's arrays, so slices can run on different threads without locking.	*/
+static void step_range(Chip8_env& env, int first, int last)
+{
+	for (int i = first; i < last; ++i)
+	{
+		if (env.needs_reset[i])
+		{
+			++env.seeds[i]; // Each new episode of an environment gets a different, but reproducible, seed.
+			reset_machine(env, i);
+		}
+
+		Chip8& chip8 = env.machines[i];
+		for (unsigned int key = 0; key < KEY_COUNT; ++key)
+			chip8.keyboard_controls[key] = (env.actions[i] >> key) & 1;
+
+		bool done = false;
+		for (int frame = 0; frame < env.frames_per_step && !done; ++frame)
+		{
+			// A fused group may run a few instructions past the end of a frame. The extra is taken off the next frame.
+			env.instructions_owed[i] += env.instructions_per_frame;
+			while (env.instructions_owed[i] > 0)
+				env.instructions_owed[i] -= chip8.cycle();
+			++env.episode_frames[i];
+			done = is_done(env, i);
+		}
+
+		u64 score = read_score(env, chip8);
+		env.rewards[i] = (float)((double)score - (double)env.scores[i]);
+		env.scores[i] = score;
+		env.dones[i] = done;
+		env.needs_reset[i] = done;
+
+		if (env.observation_format == CHIP8_OBSERVATION_PACKED)
+			chip8.pack_display((u64*)env.observations + i * Y_RESOLUTION);
+		else
+		{
+			u8* pixels = (u8*)env.observations + i * X_RESOLUTION * Y_RESOLUTION;
+			for (unsigned int p = 0; p < X_RESOLUTION * Y_RESOLUTION; ++p)
+				pixels[p] = chip8.display_array[p] & 1;
+		}
+	}
+}
+
+static void slice(Chip8_env const& env, int part, int& first, int& last)
+{
+	int parts = env.workers.size() + 1;
+	int count = env.machines.size();
+	first = (long)count * part / parts;
+	last = (long)count * (part + 1) / parts;
+}
+
+static void worker_loop(Chip8_env* env, int part)
+{
+	u64 seen_generation = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(env->mutex);
+			env->step_ready.wait(lock, [&]() { return env->stopping || env->step_generation != seen_generation; });
+			if (env->stopping)
+				return;
+			seen_generation = env->step_generation;
+		}
+
+		int first, last;
+		slice(*env, part, first, last);
+		step_range(*env, first, last);
+
+		std::lock_guard<std::mutex> lock(env->mutex);
+		if (--env->workers_running == 0)
+			env->step_finished.notify_one();
+	}
+}
+
+extern "C" {
+
+Chip8_env* chip8_env_create(const char* rom_path, int count, int threads)
+{
+	if (count <= 0)
+		return nullptr;
+
+	Chip8_env* env = new Chip8_env;
+	env->initial.clear_all();
+	if (!env->initial.load_file(rom_path))
+	{
+		delete env;
+		return nullptr;
+	}
+
+	env->machines.resize(count);
+	env->seeds.assign(count, 0);
+	env->scores.assign(count, 0);
+	env->episode_frames.assign(count, 0);
+	env->instructions_owed.assign(count, 0);
+	env->needs_reset.assign(count, 0);
+	for (int i = 0; i < count; ++i)
+	{
+		env->seeds[i] = i + 1;
+		reset_machine(*env, i);
+	}
+
+	if (threads <= 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	threads = std::min(threads, count);
+	for (int part = 1; part < threads; ++part)
+		env->workers.emplace_back(worker_loop, env, part);
+	return env;
+}
+
+void chip8_env_destroy(Chip8_env* env)
+{
+	if (!env)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(env->mutex);
+		env->stopping = true;
+	}
+	env->step_ready.notify_all();
+	for (std::thread& worker : env->workers)
+		worker.join();
+	delete env;
+}
+
+int chip8_env_count(const Chip8_env* env)
+{
+	return env->machines.size();
+}
+
+void chip8_env_set_instructions_per_frame(Chip8_env* env, int instructions_per_frame)
+{
+	env->instructions_per_frame = std::max(1, instructions_per_frame);
+}
+
+int chip8_env_set_reward(Chip8_env* env, const uint16_t* addresses, int address_count, int bcd)
+{
+	if (address_count < 0 || address_count > (int)MAX_REWARD_ADDRESSES)
+		return -1;
+	for (int i = 0; i < address_count; ++i)
+		if (addresses[i] >= MEMORY_SIZE)
+			return -1;
+
+	std::copy_n(addresses, address_count, env->reward_addresses);
+	env->reward_address_count = address_count;
+	env->reward_bcd = bcd;
+	for (size_t i = 0; i < env->machines.size(); ++i)
+		env->scores[i] = read_score(*env, env->machines[i]);
+	return 0;
+}
+
+int chip8_env_set_done(Chip8_env* env, int address, uint8_t value)
+{
+	if (address >= (int)MEMORY_SIZE)
+		return -1;
+	env->done_address = address;
+	env->done_value = value;
+	return 0;
+}
+
+void chip8_env_set_episode_frame_limit(Chip8_env* env, uint32_t frames)
+{
+	env->episode_frame_limit = frames;
+}
+
+void chip8_env_reset(Chip8_env* env, const uint32_t* seeds)
+{
+	for (size_t i = 0; i < env->machines.size(); ++i)
+	{
+		env->seeds[i] = seeds[i];
+		reset_machine(*env, i);
+	}
+}
+
+int chip8_env_step(Chip8_env* env, const uint16_t* actions, int frames_per_step,
+				   void* observations, int observation_format, float* rewards, uint8_t* dones)
+{
+	if (frames_per_step <= 0 || !actions || !observations || !rewards || !dones ||
+		(observation_format != CHIP8_OBSERVATION_PACKED && observation_format != CHIP8_OBSERVATION_BYTES))
+		return -1;
+
+	env->actions = actions;
+	env->frames_per_step = frames_per_step;
+	env->observations = observations;
+	env->observation_format = observation_format;
+	env->rewards = rewards;
+	env->dones = dones;
+
+	if (!env->workers.empty())
+	{
+		std::lock_guard<std::mutex> lock(env->mutex);
+		env->workers_running = env->workers.size();
+		++env->step_generation;
+	}
+	env->step_ready.notify_all();
+
+	int first, last;
+	slice(*env, 0, first, last);
+	step_range(*env, first, last);
+
+	std::unique_lock<std::mutex> lock(env->mutex);
+	env->step_finished.wait(lock, [&]() { return env->workers_running == 0; });
+	return 0;
+}
+
+}
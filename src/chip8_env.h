@@ -0,0 +1,51 @@
+/* C interface for running many CHIP-8 environments in lockstep, for reinforcement learning.
+
+   All arrays are owned by the caller and indexed by environment. Nothing is allocated after chip8_env_create, and
+   chip8_env_step spreads the environments over the thread pool created with the batch.
+
+   A frame is instructions_per_frame instructions (12 by default, about 700 instructions per second at 60 fps).
+   An environment is done when any of these are true, and is reset with its next seed at the start of the following step:
+     - the byte at the done address equals the done value (chip8_env_set_done)
+     - the program has stopped in a jump to itself
+     - the episode has lasted episode_frame_limit frames (0 for no limit)
+
+   The reward for a step is the change in score, where the score is the bytes at the reward addresses read as one
+   big-endian number, or as decimal digits if bcd is set (which is how Fx33 stores them). */
+
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct Chip8_env Chip8_env;
+
+enum
+{
+    CHIP8_OBSERVATION_PACKED = 0, /* 32 uint64_t rows per environment, leftmost pixel in the most significant bit. */
+    CHIP8_OBSERVATION_BYTES = 1   /* 64x32 uint8_t per environment, 0 or 1, row by row. */
+};
+
+/* Returns NULL if the rom could not be loaded. threads of 0 uses one thread per core. */
+Chip8_env* chip8_env_create(const char* rom_path, int count, int threads);
+void chip8_env_destroy(Chip8_env* env);
+
+int chip8_env_count(const Chip8_env* env);
+void chip8_env_set_instructions_per_frame(Chip8_env* env, int instructions_per_frame);
+int chip8_env_set_reward(Chip8_env* env, const uint16_t* addresses, int address_count, int bcd);
+int chip8_env_set_done(Chip8_env* env, int address, uint8_t value); /* address of -1 turns the memory check off. */
+void chip8_env_set_episode_frame_limit(Chip8_env* env, uint32_t frames);
+
+/* Resets every environment. seeds[count] seed the random number generator of each one (Cxkk). */
+void chip8_env_reset(Chip8_env* env, const uint32_t* seeds);
+
+/* actions[count] is the set of keys held down for the whole step, one bit per key (bit 0 is key 0x0).
+   Writes observations (in observation_format), rewards[count] and dones[count]. Returns 0, or -1 if an argument is invalid. */
+int chip8_env_step(Chip8_env* env, const uint16_t* actions, int frames_per_step,
+                   void* observations, int observation_format, float* rewards, uint8_t* dones);
+
+#ifdef __cplusplus
+}
+#endif
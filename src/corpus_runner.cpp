@@ -0,0 +1,409 @@
+/* Conformance and throughput gate for the interpreter. Runs a corpus of roms headless and compares them against golden files. */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#include "chip8.hpp"
+
+const u32 CORPUS_SEED = 0xC8C8C8C8; // Every rom is seeded the same so that Cxkk is reproducible.
+const double DEFAULT_THRESHOLD = 0.25; // Fraction of the baseline instructions per second a rom may lose before it is flagged.
+
+struct Key_event
+{
+	u64 instruction;
+	u8 key;
+	u8 state;
+};
+
+/*	One line of a corpus manifest:
+		<name> <rom> <instructions> <checkpoint every> [input script]
+	Paths are relative to the manifest. The golden file for an entry is golden/<name>.golden next to the manifest, and holds
+	only the checkpoints. Its throughput baseline depends on the machine, so it is kept apart in baselines/<name>.baseline
+	(baselines/<name>.nofusion.baseline for --no-fusion), is not committed, and is recorded by the first run on each machine.	*/
+struct Corpus_entry
+{
+	std::string name;
+	std::string rom_path;
+	u64 instruction_budget;
+	u64 checkpoint_every;
+	std::string input_path;
+	std::vector<Key_event> inputs;
+	std::unique_ptr<Chip8> chip8;
+
+	std::vector<std::string> checkpoints;
+	double instructions_per_second;
+	std::string error;
+};
+
+static std::string directory_of(std::string const& path)
+{
+	size_t slash = path.find_last_of('/');
+	return slash == std::string::npos ? "" : path.substr(0, slash + 1);
+}
+
+/*	Input scripts have one key event per line: <instruction> <key in hex> <down|up>. Events must be in instruction order.	*/
+static bool load_input_script(std::string const& path, std::vector<Key_event>& inputs)
+{
+	std::ifstream file(path);
+	if (!file.is_open())
+		return false;
+
+	std::string line;
+	while (std::getline(file, line))
+	{
+		if (line.empty() || line[0] == '#')
+			continue;
+
+		std::istringstream fields(line);
+		Key_event event;
+		unsigned int key;
+		std::string state;
+		if (!(fields >> event.instruction >> std::hex >> key >> state) || key >= KEY_COUNT)
+			return false;
+		event.key = key;
+		event.state = state == "down";
+		inputs.push_back(event);
+	}
+	return true;
+}
+
+static bool load_manifest(std::string const& path, std::vector<Corpus_entry>& entries)
+{
+	std::ifstream file(path);
+	if (!file.is_open())
+	{
+		cout << "Could not open corpus manifest " << path << ".\n";
+		return false;
+	}
+
+	std::string directory = directory_of(path);
+	std::string line;
+	while (std::getline(file, line))
+	{
+		if (line.empty() || line[0] == '#')
+			continue;
+
+		std::istringstream fields(line);
+		Corpus_entry entry;
+		if (!(fields >> entry.name >> entry.rom_path >> entry.instruction_budget >> entry.checkpoint_every) || entry.checkpoint_every == 0)
+		{
+			cout << "Bad corpus line: " << line << '\n';
+			return false;
+		}
+		entry.rom_path = directory + entry.rom_path;
+		if (fields >> entry.input_path)
+		{
+			entry.input_path = directory + entry.input_path;
+			if (!load_input_script(entry.input_path, entry.inputs))
+			{
+				cout << "Bad input script " << entry.input_path << ".\n";
+				return false;
+			}
+		}
+		entries.push_back(std::move(entry));
+	}
+	return true;
+}
+
+/*	64-bit FNV-1a over the display packed to one bit per pixel.	*/
+static u64 hash_display(Chip8 const& chip8)
+{
+	u64 rows[Y_RESOLUTION];
+	chip8.pack_display(rows);
+
+	u64 hash = 0xCBF29CE484222325;
+	for (u64 row : rows)
+		for (int i = 0; i < 8; ++i)
+		{
+			hash ^= (row >> (8 * i)) & 0xFF;
+			hash *= 0x100000001B3;
+		}
+	return hash;
+}
+
+static std::string format_checkpoint(u64 instruction, Chip8 const& chip8)
+{
+	std::ostringstream line;
+	line << instruction << std::hex << std::setfill('0')
+		 << " fb=" << std::setw(16) << hash_display(chip8)
+		 << " pc=" << std::setw(3) << chip8.get_program_counter()
+		 << " i=" << std::setw(3) << chip8.get_index_register()
+		 << " dt=" << std::setw(2) << (int)chip8.delay_timer
+		 << " v=";
+	for (unsigned int i = 0; i < REGISTERS_COUNT; ++i)
+		line << std::setw(2) << (int)chip8.get_V_registers()[i];
+	return line.str();
+}
+
+/*	Runs one entry for exactly its instruction budget. cycle() is used while a whole fused group still fits before the next
+	checkpoint or key event, then step() makes up the rest, so checkpoints land on the same instruction whether or not fusion is on.	*/
+static void run_entry(Corpus_entry& entry)
+{
+	Chip8& chip8 = *entry.chip8;
+	const u64 LONGEST_FUSED_GROUP = 4;
+	u64 executed = 0;
+	size_t next_input = 0;
+	u64 next_checkpoint = entry.checkpoint_every;
+
+	auto start = std::chrono::steady_clock::now();
+	try
+	{
+		while (executed < entry.instruction_budget)
+		{
+			while (next_input < entry.inputs.size() && entry.inputs[next_input].instruction <= executed)
+			{
+				chip8.keyboard_controls[entry.inputs[next_input].key] = entry.inputs[next_input].state;
+				++next_input;
+			}
+
+			u64 stop = std::min(next_checkpoint, entry.instruction_budget);
+			if (next_input < entry.inputs.size())
+				stop = std::min(stop, entry.inputs[next_input].instruction);
+
+			while (executed + LONGEST_FUSED_GROUP <= stop)
+				executed += chip8.cycle();
+			while (executed < stop)
+			{
+				chip8.step();
+				++executed;
+			}
+
+			if (executed == next_checkpoint)
+			{
+				entry.checkpoints.push_back(format_checkpoint(executed, chip8));
+				next_checkpoint += entry.checkpoint_every;
+			}
+		}
+	}
+	catch (std::exception const& exception)
+	{
+		entry.error = exception.what();
+	}
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	entry.instructions_per_second = seconds > 0 ? executed / seconds : 0;
+}
+
+static std::string golden_path(std::string const& manifest_path, Corpus_entry const& entry)
+{
+	return directory_of(manifest_path) + "golden/" + entry.name + ".golden";
+}
+
+static std::string baseline_path(std::string const& manifest_path, Corpus_entry const& entry, bool fusion)
+{
+	return directory_of(manifest_path) + "baselines/" + entry.name + (fusion ? ".baseline" : ".nofusion.baseline");
+}
+
+static bool write_golden(std::string const& path, Corpus_entry const& entry)
+{
+	std::ofstream file(path);
+	if (!file.is_open())
+		return false;
+
+	for (std::string const& checkpoint : entry.checkpoints)
+		file << "checkpoint " << checkpoint << '\n';
+	return true;
+}
+
+static bool read_golden(std::string const& path, std::vector<std::string>& checkpoints)
+{
+	std::ifstream file(path);
+	if (!file.is_open())
+		return false;
+
+	std::string line;
+	while (std::getline(file, line))
+		if (line.compare(0, 11, "checkpoint ") == 0)
+			checkpoints.push_back(line.substr(11));
+	return true;
+}
+
+static bool write_baseline(std::string const& path, Corpus_entry const& entry)
+{
+	std::error_code error;
+	std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+	std::ofstream file(path);
+	if (!file.is_open())
+		return false;
+
+	file << "ips " << (u64)entry.instructions_per_second << '\n';
+	return true;
+}
+
+/*	Returns false if there is no baseline yet.	*/
+static bool read_baseline(std::string const& path, double& instructions_per_second)
+{
+	std::ifstream file(path);
+	std::string line;
+	while (std::getline(file, line))
+		if (line.compare(0, 4, "ips ") == 0)
+			instructions_per_second = std::stod(line.substr(4));
+	return instructions_per_second > 0;
+}
+
+/*	Returns an empty string if the checkpoints match, otherwise what differs.	*/
+static std::string compare_checkpoints(std::vector<std::string> const& expected, std::vector<std::string> const& actual)
+{
+	if (expected.size() != actual.size())
+		return "expected " + std::to_string(expected.size()) + " checkpoints, got " + std::to_string(actual.size());
+
+	for (size_t i = 0; i < expected.size(); ++i)
+		if (expected[i] != actual[i])
+			return "expected " + expected[i] + "\n" + std::string(28, ' ') + "got      " + actual[i];
+	return "";
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		cout << "Usage: corpus_runner <manifest> [--record [--force]] [--no-fusion] [--jobs <n>] [--threshold <fraction>]\n";
+		return 2;
+	}
+
+	std::string manifest_path = argv[1];
+	bool record = false;
+	bool force = false;
+	bool fusion = true;
+	unsigned int jobs = std::max(1u, std::thread::hardware_concurrency());
+	double threshold = DEFAULT_THRESHOLD;
+
+	for (int i = 2; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--record") == 0)
+			record = true;
+		else if (strcmp(argv[i], "--force") == 0)
+			force = true;
+		else if (strcmp(argv[i], "--no-fusion") == 0)
+			fusion = false;
+		else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc)
+			jobs = std::max(1, atoi(argv[++i]));
+		else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc)
+			threshold = atof(argv[++i]);
+		else
+			cout << "Ignoring unknown option " << argv[i] << ".\n";
+	}
+
+	std::vector<Corpus_entry> entries;
+	if (!load_manifest(manifest_path, entries))
+		return 2;
+
+	// Roms are loaded up front, one at a time, so that loading messages are not interleaved between threads.
+	for (Corpus_entry& entry : entries)
+	{
+		entry.chip8.reset(new Chip8{});
+		entry.chip8->clear_all();
+		if (!entry.chip8->load_file(entry.rom_path))
+			entry.error = "could not load rom";
+		entry.chip8->seed_random(CORPUS_SEED);
+		entry.chip8->set_fusion(fusion);
+	}
+
+	std::atomic<size_t> next_entry {0};
+	std::vector<std::thread> workers;
+	for (unsigned int i = 0; i < std::min<size_t>(jobs, entries.size()); ++i)
+		workers.emplace_back([&]()
+		{
+			size_t index;
+			while ((index = next_entry++) < entries.size())
+				if (entries[index].error.empty())
+					run_entry(entries[index]);
+		});
+	for (std::thread& worker : workers)
+		worker.join();
+
+	int failures = 0;
+	int regressions = 0;
+
+	cout << '\n' << std::left << std::setw(16) << "rom" << std::setw(12) << "result"
+		 << std::right << std::setw(14) << "instr/s" << std::setw(14) << "baseline" << std::setw(10) << "change" << '\n';
+
+	// Recording never quietly changes what counts as correct: an existing golden is only rewritten with --force, and a baseline
+	// is only recorded for an entry whose checkpoints match its golden, so re-baselining on new hardware approves nothing.
+	// An entry with no baseline for this mode gets one from this run, so the first run on a machine sets what later runs are held to.
+	for (Corpus_entry const& entry : entries)
+	{
+		std::string result = "PASS";
+		std::string detail;
+		double baseline = 0;
+		std::string golden = golden_path(manifest_path, entry);
+		std::vector<std::string> expected;
+		bool has_golden = read_golden(golden, expected);
+
+		if (!entry.error.empty())
+		{
+			result = "ERROR";
+			detail = entry.error;
+		}
+		else if (has_golden && !(record && force))
+		{
+			detail = compare_checkpoints(expected, entry.checkpoints);
+			if (!detail.empty())
+			{
+				result = "FAIL";
+				if (record)
+					detail += "\n" + std::string(28, ' ') + "not recorded, use --force to replace " + golden;
+			}
+		}
+		else if (!has_golden && !record)
+		{
+			result = "NO GOLDEN";
+			detail = "run with --record to create " + golden;
+		}
+		else if (!write_golden(golden, entry))
+		{
+			result = "ERROR";
+			detail = "could not write " + golden;
+		}
+		else
+			result = "RECORDED";
+
+		if (result == "PASS" || result == "RECORDED")
+		{
+			std::string path = baseline_path(manifest_path, entry, fusion);
+			bool has_baseline = read_baseline(path, baseline);
+			if (record || !has_baseline)
+			{
+				baseline = 0;
+				if (!write_baseline(path, entry))
+				{
+					result = "ERROR";
+					detail = "could not write " + path;
+				}
+				else if (result == "PASS")
+					result = has_baseline ? "REBASELINED" : "BASELINED";
+			}
+			else if (entry.instructions_per_second < baseline * (1 - threshold))
+				result = "SLOW";
+		}
+
+		if (result == "SLOW")
+			++regressions;
+		else if (result != "PASS" && result != "RECORDED" && result != "REBASELINED" && result != "BASELINED")
+			++failures;
+
+		cout << std::left << std::setw(16) << entry.name << std::setw(12) << result << std::right << std::fixed << std::setprecision(1)
+			 << std::setw(13) << entry.instructions_per_second / 1e6 << 'M';
+		if (baseline > 0)
+			cout << std::setw(13) << baseline / 1e6 << 'M' << std::showpos << std::setw(9) << 100 * (entry.instructions_per_second / baseline - 1) << '%' << std::noshowpos;
+		cout << '\n';
+		if (!detail.empty())
+			cout << std::string(28, ' ') << detail << '\n';
+		if (entry.chip8->get_trapped_op_code_count())
+			cout << std::string(28, ' ') << entry.chip8->get_trapped_op_code_count() << " unknown op codes skipped, the last was "
+				 << std::hex << std::uppercase << entry.chip8->get_last_trapped_op_code() << std::dec << std::nouppercase << '\n';
+	}
+
+	cout << '\n' << entries.size() << " roms, " << failures << " failed, " << regressions << " slower than " << (1 - threshold) * 100 << "% of baseline.\n";
+	return failures || regressions ? 1 : 0;
+}
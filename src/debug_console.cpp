@@ -0,0 +1,119 @@
+#include <iostream>
+#include <errno.h>
+#include <string.h>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "debug_console.hpp"
+#include "unix_socket.hpp"
+
+const size_t MAX_COMMAND_LENGTH = 256;
+
+Debug_console::~Debug_console()
+{
+	end_console();
+}
+
+/*	Starts listening for a client at path. See listen_on_unix_socket for what happens to an existing file there.	*/
+bool Debug_console::begin_console(char const* path, Debugger& debugger)
+{
+	listen_fd = listen_on_unix_socket(path, 1, "debug");
+	if (listen_fd < 0)
+		return false;
+
+	socket_path = path;
+	debugger.collect_output(true);
+	cout << "Debug console on " << path << ".\n";
+	return true;
+}
+
+void Debug_console::end_console()
+{
+	drop_client();
+	if (listen_fd >= 0)
+	{
+		close(listen_fd);
+		unlink(socket_path.c_str());
+		listen_fd = -1;
+	}
+}
+
+/*	Accepts a client if there is none, runs any complete command lines it sent and passes on what the debugger reported.	*/
+void Debug_console::service(Debugger& debugger)
+{
+	if (listen_fd < 0)
+		return;
+
+	accept_client(debugger);
+	std::string reports = debugger.take_output();
+	if (client_fd < 0)
+		return;
+
+	if (!read_commands(debugger) || !send_text(reports))
+		drop_client();
+}
+
+/*	A second client is turned away while one is connected.	*/
+void Debug_console::accept_client(Debugger& debugger)
+{
+	int fd;
+	while ((fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+	{
+		if (client_fd >= 0)
+		{
+			close(fd);
+			continue;
+		}
+		client_fd = fd;
+		input.clear();
+		if (!send_text(debugger.execute("help")))
+			drop_client();
+	}
+}
+
+/*	Returns false once the client has disconnected.	*/
+bool Debug_console::read_commands(Debugger& debugger)
+{
+	char buffer[256];
+	while (true)
+	{
+		ssize_t received = recv(client_fd, buffer, sizeof(buffer), 0);
+		if (received == 0)
+			return false;
+		if (received < 0)
+			return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+
+		input.append(buffer, received);
+		size_t end;
+		while ((end = input.find('\n')) != std::string::npos)
+		{
+			std::string command = input.substr(0, end);
+			input.erase(0, end + 1);
+			if (!command.empty() && command.back() == '\r')
+				command.pop_back();
+			if (!send_text(debugger.execute(command) + debugger.take_output()))
+				return false;
+		}
+		if (input.size() > MAX_COMMAND_LENGTH)
+			input.clear();
+	}
+}
+
+/*	Replies are short, so anything the socket will not take straight away is dropped rather than queued.	*/
+bool Debug_console::send_text(std::string const& text)
+{
+	if (text.empty())
+		return true;
+	ssize_t sent = send(client_fd, text.data(), text.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+	return sent >= 0 || errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+}
+
+void Debug_console::drop_client()
+{
+	if (client_fd >= 0)
+	{
+		close(client_fd);
+		client_fd = -1;
+	}
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string>
+
+#include "debugger.hpp"
+
+/*	Accepts one client at a time on a Unix domain socket and runs the lines it sends as Debugger commands, for example
+	"break 2A4 if V3 == 10" or "watch w 3F0 4". Replies, and reports of where the program stopped, are sent back as text.
+	Everything is non-blocking, so service() can be called from the emulation loop, paused or not. Try it with
+	socat - UNIX-CONNECT:<path>.	*/
+class Debug_console
+{
+    private:
+        int listen_fd = -1;
+        int client_fd = -1;
+        std::string socket_path;
+        std::string input; // Received text that does not end in a newline yet.
+
+        void accept_client(Debugger& debugger);
+        bool read_commands(Debugger& debugger);
+        bool send_text(std::string const& text);
+        void drop_client();
+
+    public:
+        Debug_console() = default;
+        ~Debug_console();
+        bool begin_console(char const* path, Debugger& debugger);
+        void service(Debugger& debugger);
+        void end_console();
+};
@@ -0,0 +1,486 @@
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "debugger.hpp"
+#include "disassembler.hpp"
+
+const int DEFAULT_LIST_COUNT = 10;
+
+static const char* comparison_names[] = {"==", "!=", "<", ">", "<=", ">="};
+
+static const char* help_text =
+	"break <addr> [if <reg> <op> <value>]   stop before addr; reg is V0-VF or I, op is == != < > <= >=\n"
+	"break * if <reg> <op> <value>          stop before any instruction when the condition holds\n"
+	"delete <addr>|*                        remove the breakpoint and conditions at addr, or the ones at *\n"
+	"watch r|w|rw <addr> [length]           stop before an instruction reads or writes the range\n"
+	"unwatch <addr> [length]\n"
+	"continue | pause | step [n] | next     next steps over a 2nnn call\n"
+	"regs | list [addr] [count] | info | help\n"
+	"Addresses and values are hex.\n";
+
+static std::string describe_condition(Register_condition const& condition)
+{
+	char text[24];
+	if (condition.register_index == CONDITION_REGISTER_I)
+		snprintf(text, sizeof(text), "I %s %X", comparison_names[condition.comparison], condition.value);
+	else
+		snprintf(text, sizeof(text), "V%X %s %X", condition.register_index, comparison_names[condition.comparison], condition.value);
+	return text;
+}
+
+void Debugger::begin_debugger(Chip8* target, bool start_paused)
+{
+	chip8 = target;
+	paused = start_paused;
+	*log << "Debugger ready: F5 continue/pause, F9 breakpoint at PC, F10 step over, F11 step.\n";
+	if (paused)
+		report("Paused at " + describe_position());
+}
+
+/*	The instrumented path. Runs up to instructions single steps, checking breakpoints, conditions and watchpoints before each one.
+	While paused it only runs the steps asked for, and those stop early on the same checks.	*/
+int Debugger::run(int instructions)
+{
+	int executed = 0;
+	std::string reason;
+	while (executed < instructions)
+	{
+		if (paused && !steps_left)
+			break;
+
+		if (resume_past_stop)
+			resume_past_stop = false;
+		else if (should_stop(reason))
+		{
+			stop(reason);
+			break;
+		}
+
+		chip8->step();
+		++executed;
+		if (paused && --steps_left == 0)
+			report(describe_position());
+	}
+	return executed;
+}
+
+/*	The program counter can run past 0xFFF (e.g. Bnnn), and op codes are fetched from it wrapped to memory, so it is wrapped here too.	*/
+bool Debugger::should_stop(std::string& reason) const
+{
+	u16 address = chip8->get_program_counter() & (MEMORY_SIZE - 1);
+
+	if (stepping_over && address == step_over_address && chip8->get_stack_pointer() <= step_over_depth)
+	{
+		reason = "Stepped over to";
+		return true;
+	}
+	if (breakpoints[address])
+	{
+		reason = "Breakpoint at";
+		return true;
+	}
+	if (any_address_conditions || condition_addresses[address])
+	{
+		for (Register_condition const& condition : conditions)
+		{
+			if ((condition.address == -1 || condition.address == address) && condition_holds(condition))
+			{
+				reason = "Condition " + describe_condition(condition) + " at";
+				return true;
+			}
+		}
+	}
+	if (watched_pages[WATCH_READ] | watched_pages[WATCH_WRITE])
+		return touches_watch(chip8->op_code_at(address), reason);
+	return false;
+}
+
+bool Debugger::condition_holds(Register_condition const& condition) const
+{
+	u16 value = condition.register_index == CONDITION_REGISTER_I ? chip8->get_index_register()
+	                                                             : chip8->get_V_registers()[condition.register_index];
+	switch (condition.comparison)
+	{
+		case (COMPARE_EQUAL): return value == condition.value;
+		case (COMPARE_NOT_EQUAL): return value != condition.value;
+		case (COMPARE_LESS): return value < condition.value;
+		case (COMPARE_GREATER): return value > condition.value;
+		case (COMPARE_LESS_OR_EQUAL): return value <= condition.value;
+		case (COMPARE_GREATER_OR_EQUAL): return value >= condition.value;
+	}
+	return false;
+}
+
+/*	Works out which memory the op code is about to read or write, then checks the page bitmap before looking at single addresses.	*/
+bool Debugger::touches_watch(u16 op_code, std::string& reason) const
+{
+	unsigned int x = (op_code & 0x0F00) >> 8;
+	unsigned int length;
+	u8 access;
+
+	if ((op_code & 0xF0FF) == 0xF055)
+		access = WATCH_WRITE, length = x + 1;
+	else if ((op_code & 0xF0FF) == 0xF033)
+		access = WATCH_WRITE, length = 3;
+	else if ((op_code & 0xF0FF) == 0xF065)
+		access = WATCH_READ, length = x + 1;
+	else if ((op_code & 0xF000) == 0xD000)
+		access = WATCH_READ, length = op_code & 0x000F;
+	else
+		return false;
+
+	if (length == 0)
+		return false;
+
+	// Accesses wrap around the end of memory like Paged_memory::read and write. At most 16 bytes are touched,
+	// so the range is in the page of its first byte and the page of its last.
+	unsigned int first = chip8->get_index_register() & (MEMORY_SIZE - 1);
+	unsigned int last = (first + length - 1) & (MEMORY_SIZE - 1);
+	u16 pages = (u16)((1u << (first / WATCH_PAGE_SIZE)) | (1u << (last / WATCH_PAGE_SIZE)));
+	if (!(pages & watched_pages[access]))
+		return false;
+
+	for (unsigned int i = 0; i < length; ++i)
+	{
+		unsigned int address = (first + i) & (MEMORY_SIZE - 1);
+		if (watches[address] & access)
+		{
+			char text[48];
+			snprintf(text, sizeof(text), "Watchpoint (%s 0x%03X) at", access == WATCH_WRITE ? "write" : "read", address);
+			reason = text;
+			return true;
+		}
+	}
+	return false;
+}
+
+void Debugger::update_watched_pages()
+{
+	watched_pages[WATCH_READ] = watched_pages[WATCH_WRITE] = 0;
+	for (unsigned int address = 0; address < MEMORY_SIZE; ++address)
+	{
+		if (watches[address] & WATCH_READ)
+			watched_pages[WATCH_READ] |= 1 << (address / WATCH_PAGE_SIZE);
+		if (watches[address] & WATCH_WRITE)
+			watched_pages[WATCH_WRITE] |= 1 << (address / WATCH_PAGE_SIZE);
+	}
+}
+
+void Debugger::stop(std::string const& reason)
+{
+	paused = true;
+	stepping_over = false;
+	steps_left = 0;
+	report(reason + " " + describe_position());
+}
+
+void Debugger::report(std::string const& line)
+{
+	*log << line << '\n';
+	if (keep_output)
+		output += line + '\n';
+}
+
+std::string Debugger::take_output()
+{
+	std::string taken;
+	taken.swap(output);
+	return taken;
+}
+
+std::string Debugger::describe_position() const
+{
+	char text[48];
+	u16 address = chip8->get_program_counter();
+	snprintf(text, sizeof(text), "0x%03X: ", address);
+	return text + disassemble(chip8->op_code_at(address));
+}
+
+std::string Debugger::describe_registers() const
+{
+	char text[160];
+	u8 const* V = chip8->get_V_registers();
+	int length = 0;
+	for (unsigned int i = 0; i < REGISTERS_COUNT; ++i)
+		length += snprintf(text + length, sizeof(text) - length, "V%X=%02X%s", i, V[i], i == 7 ? "\n" : i == 15 ? "" : " ");
+	snprintf(text + length, sizeof(text) - length, "\nI=%03X PC=%03X SP=%X DT=%02X ST=%02X\n", chip8->get_index_register(),
+	         chip8->get_program_counter(), chip8->get_stack_pointer(), chip8->delay_timer, chip8->get_sound_timer());
+	return text;
+}
+
+std::string Debugger::list(u16 address, int count) const
+{
+	std::string text;
+	char line[16];
+	for (int i = 0; i < count && address + 1u < MEMORY_SIZE; ++i, address += 2)
+	{
+		snprintf(line, sizeof(line), "%c%c0x%03X  ", breakpoints[address] ? '*' : ' ', address == chip8->get_program_counter() ? '>' : ' ', address);
+		text += line + disassemble(chip8->op_code_at(address)) + '\n';
+	}
+	return text;
+}
+
+std::string Debugger::describe_breakpoints() const
+{
+	std::string text;
+	char line[64];
+	for (unsigned int address = 0; address < MEMORY_SIZE; ++address)
+	{
+		if (breakpoints[address])
+		{
+			snprintf(line, sizeof(line), "break 0x%03X\n", address);
+			text += line;
+		}
+	}
+	for (Register_condition const& condition : conditions)
+	{
+		char where[8] = "*";
+		if (condition.address != -1)
+			snprintf(where, sizeof(where), "0x%03X", condition.address);
+		text += std::string("break ") + where + " if " + describe_condition(condition) + '\n';
+	}
+	for (unsigned int address = 0; address < MEMORY_SIZE; ++address)
+	{
+		if (watches[address])
+		{
+			unsigned int end = address;
+			while (end + 1 < MEMORY_SIZE && watches[end + 1] == watches[address])
+				++end;
+			const char* access = watches[address] == (WATCH_READ | WATCH_WRITE) ? "rw" : watches[address] == WATCH_READ ? "r" : "w";
+			snprintf(line, sizeof(line), "watch %s 0x%03X %X\n", access, address, end - address + 1);
+			text += line;
+			address = end;
+		}
+	}
+	return text.empty() ? "No breakpoints or watchpoints.\n" : text;
+}
+
+void Debugger::pause()
+{
+	if (paused)
+		return;
+	paused = true;
+	stepping_over = false;
+	report("Paused at " + describe_position());
+}
+
+void Debugger::resume()
+{
+	if (!paused)
+		return;
+	paused = false;
+	resume_past_stop = true;
+}
+
+void Debugger::step_into(int count)
+{
+	pause();
+	steps_left = std::max(1, count);
+	resume_past_stop = true;
+}
+
+/*	Runs a 2nnn call until it returns to the next instruction at the same stack depth, so recursion does not stop it early.
+	Anything else is a single step.	*/
+void Debugger::step_over()
+{
+	pause();
+	u16 address = chip8->get_program_counter();
+	if ((chip8->op_code_at(address) & 0xF000) != 0x2000)
+	{
+		step_into(1);
+		return;
+	}
+	stepping_over = true;
+	step_over_address = (address + 2) & (MEMORY_SIZE - 1);
+	step_over_depth = chip8->get_stack_pointer();
+	paused = false;
+	resume_past_stop = true;
+}
+
+void Debugger::toggle_breakpoint(u16 address)
+{
+	set_breakpoint(address, !breakpoints[address]);
+	char text[32];
+	snprintf(text, sizeof(text), "Breakpoint %s 0x%03X", breakpoints[address] ? "set at" : "removed from", address);
+	report(text);
+}
+
+void Debugger::set_breakpoint(u16 address, bool enabled)
+{
+	if (address >= MEMORY_SIZE || breakpoints[address] == enabled)
+		return;
+	breakpoints[address] = enabled;
+	breakpoint_count += enabled ? 1 : -1;
+}
+
+void Debugger::add_condition(Register_condition const& condition)
+{
+	conditions.push_back(condition);
+	if (condition.address == -1)
+		any_address_conditions = true;
+	else
+		condition_addresses[condition.address] = true;
+}
+
+void Debugger::remove_at(int address)
+{
+	if (address != -1)
+	{
+		set_breakpoint(address, false);
+		condition_addresses[address] = false;
+	}
+	conditions.erase(std::remove_if(conditions.begin(), conditions.end(),
+	                                [&](Register_condition const& condition) { return condition.address == address; }),
+	                 conditions.end());
+	any_address_conditions = std::any_of(conditions.begin(), conditions.end(),
+	                                     [](Register_condition const& condition) { return condition.address == -1; });
+}
+
+void Debugger::set_watch(u16 address, int length, u8 access)
+{
+	for (unsigned int i = address; i < MEMORY_SIZE && i < address + (unsigned int)std::max(1, length); ++i)
+		watches[i] = access;
+	update_watched_pages();
+}
+
+static bool parse_hex(std::string const& text, long& value)
+{
+	char* end;
+	value = strtol(text.c_str(), &end, 16);
+	return !text.empty() && *end == '\0';
+}
+
+/*	Parses "<reg> <op> <value>" after "if". Returns false if any part is missing or malformed.	*/
+static bool parse_condition(std::istringstream& words, Register_condition& condition)
+{
+	std::string reg, comparison, value_text;
+	long value;
+	if (!(words >> reg >> comparison >> value_text) || !parse_hex(value_text, value))
+		return false;
+
+	if (reg == "I" || reg == "i")
+		condition.register_index = CONDITION_REGISTER_I;
+	else if (reg.size() == 2 && (reg[0] == 'V' || reg[0] == 'v') && isxdigit((unsigned char)reg[1]))
+		condition.register_index = strtol(reg.c_str() + 1, nullptr, 16);
+	else
+		return false;
+
+	const Comparison comparisons[] = {COMPARE_EQUAL, COMPARE_NOT_EQUAL, COMPARE_LESS, COMPARE_GREATER, COMPARE_LESS_OR_EQUAL, COMPARE_GREATER_OR_EQUAL};
+	for (Comparison c : comparisons)
+	{
+		if (comparison == comparison_names[c])
+		{
+			condition.comparison = c;
+			condition.value = value;
+			return true;
+		}
+	}
+	return false;
+}
+
+std::string Debugger::execute(std::string const& command)
+{
+	std::istringstream words(command);
+	std::string verb, first, second, third;
+	long address, length;
+	words >> verb;
+
+	if (verb.empty())
+		return "";
+	if (verb == "help")
+		return help_text;
+	if (verb == "continue" || verb == "c")
+	{
+		resume();
+		return "Running.\n";
+	}
+	if (verb == "pause" || verb == "p")
+	{
+		pause();
+		return "";
+	}
+	if (verb == "step" || verb == "s")
+	{
+		long count = 1;
+		if (words >> first && !parse_hex(first, count))
+			return "Usage: step [n]\n";
+		step_into(count);
+		return "";
+	}
+	if (verb == "next" || verb == "n")
+	{
+		step_over();
+		return "";
+	}
+	if (verb == "regs" || verb == "r")
+		return describe_registers();
+	if (verb == "list" || verb == "l")
+	{
+		address = chip8->get_program_counter();
+		length = DEFAULT_LIST_COUNT;
+		if (words >> first && !parse_hex(first, address))
+			return "Usage: list [addr] [count]\n";
+		if (words >> second && !parse_hex(second, length))
+			return "Usage: list [addr] [count]\n";
+		return list(address & 0xFFF, length);
+	}
+	if (verb == "info" || verb == "i")
+		return describe_breakpoints();
+	if (verb == "break" || verb == "b")
+	{
+		if (!(words >> first))
+			return "Usage: break <addr> [if <reg> <op> <value>]\n";
+
+		Register_condition condition {-1, 0, COMPARE_EQUAL, 0};
+		if (first != "*")
+		{
+			if (!parse_hex(first, address) || address < 0 || address >= (long)MEMORY_SIZE)
+				return "Usage: break <addr> [if <reg> <op> <value>]\n";
+			condition.address = address;
+		}
+		if (!(words >> second))
+		{
+			if (condition.address == -1)
+				return "break * needs a condition.\n";
+			set_breakpoint(condition.address, true);
+			return "Breakpoint set.\n";
+		}
+		if (second != "if" || !parse_condition(words, condition))
+			return "Usage: break <addr> [if <reg> <op> <value>]\n";
+		add_condition(condition);
+		return "Conditional breakpoint set.\n";
+	}
+	if (verb == "delete" || verb == "d")
+	{
+		if (!(words >> first))
+			return "Usage: delete <addr>|*\n";
+		if (first == "*")
+			address = -1;
+		else if (!parse_hex(first, address) || address < 0 || address >= (long)MEMORY_SIZE)
+			return "Usage: delete <addr>|*\n";
+		remove_at(address);
+		return "Deleted.\n";
+	}
+	if (verb == "watch" || verb == "w" || verb == "unwatch")
+	{
+		u8 access = 0;
+		if (verb != "unwatch")
+		{
+			words >> third;
+			access = third == "r" ? WATCH_READ : third == "w" ? WATCH_WRITE : third == "rw" ? WATCH_READ | WATCH_WRITE : 0;
+			if (!access)
+				return "Usage: watch r|w|rw <addr> [length]\n";
+		}
+		length = 1;
+		if (!(words >> first) || !parse_hex(first, address) || address < 0 || address >= (long)MEMORY_SIZE)
+			return "Usage: " + verb + (access ? " r|w|rw" : "") + " <addr> [length]\n";
+		if (words >> second && !parse_hex(second, length))
+			return "Usage: " + verb + (access ? " r|w|rw" : "") + " <addr> [length]\n";
+		set_watch(address, length, access);
+		return access ? "Watchpoint set.\n" : "Watchpoint removed.\n";
+	}
+	return "Unknown command, try help.\n";
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <bitset>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "chip8.hpp"
+
+const unsigned int WATCH_PAGE_SIZE = 256; // Memory is 16 pages, so a page bitmap fits in a u16.
+const unsigned int CONDITION_REGISTER_I = 16; // Register index used for I in conditions. 0 to 15 are V0 to VF.
+
+enum Watch_access : u8
+{
+    WATCH_READ = 1,
+    WATCH_WRITE = 2
+};
+
+enum Comparison : u8
+{
+    COMPARE_EQUAL,
+    COMPARE_NOT_EQUAL,
+    COMPARE_LESS,
+    COMPARE_GREATER,
+    COMPARE_LESS_OR_EQUAL,
+    COMPARE_GREATER_OR_EQUAL
+};
+
+/*	Stops before the instruction at address (or at any address, if address is -1) when the register comparison holds.	*/
+struct Register_condition
+{
+    int address;
+    u8 register_index;
+    Comparison comparison;
+    u16 value;
+};
+
+/*	Breakpoints, register conditions, memory watchpoints and stepping for one Chip8.
+
+	Nothing here is on the normal path: while active() is false the frontend keeps calling Chip8::cycle() as before.
+	While it is true the frontend calls run() instead, which executes one unfused step() at a time and checks before each one.
+	Watchpoints are found by decoding the instruction about to run: Fx55 and Fx33 write memory from I, Fx65 and Dxyn read it.
+	The range it touches is first tested against a bitmap of 256 byte pages that have any watch in them, so instructions that
+	touch no watched page cost one mask test.
+
+	Text commands (see execute()) can come from the debug console socket; the SDL window maps F5, F9, F10 and F11.	*/
+class Debugger
+{
+    private:
+        Chip8* chip8 = nullptr;
+        std::bitset<MEMORY_SIZE> breakpoints;
+        unsigned int breakpoint_count {};
+        std::vector<Register_condition> conditions;
+        std::bitset<MEMORY_SIZE> condition_addresses; // Addresses with at least one condition.
+        bool any_address_conditions = false;
+        u8 watches[MEMORY_SIZE] {}; // Watch_access bits for each address.
+        u16 watched_pages[3] {}; // Indexed by Watch_access: a bit for each page with a watch of that kind.
+        bool paused = false;
+        bool resume_past_stop = false; // Run the instruction the debugger stopped at without stopping on it again.
+        int steps_left {};
+        bool stepping_over = false;
+        u16 step_over_address {};
+        u8 step_over_depth {};
+        std::string output;
+        bool keep_output = false;
+        std::ostream* log = &cout;
+
+        bool should_stop(std::string& reason) const;
+        bool condition_holds(Register_condition const& condition) const;
+        bool touches_watch(u16 op_code, std::string& reason) const;
+        void update_watched_pages();
+        void stop(std::string const& reason);
+        void report(std::string const& line);
+        std::string describe_position() const;
+        std::string describe_registers() const;
+        std::string list(u16 address, int count) const;
+        std::string describe_breakpoints() const;
+
+    public:
+        Debugger() = default;
+        void begin_debugger(Chip8* target, bool start_paused);
+        bool active() const
+        {
+            return paused || steps_left || stepping_over || breakpoint_count || !conditions.empty() || watched_pages[WATCH_READ] || watched_pages[WATCH_WRITE];
+        }
+        bool is_paused() const { return paused; }
+        int run(int instructions); // Returns the number of instructions executed, which is fewer if something stopped it.
+
+        void pause();
+        void resume();
+        void step_into(int count);
+        void step_over();
+        void toggle_breakpoint(u16 address);
+        void toggle_breakpoint_at_pc() { toggle_breakpoint(chip8->get_program_counter() & (MEMORY_SIZE - 1)); }
+        void set_breakpoint(u16 address, bool enabled);
+        void add_condition(Register_condition const& condition);
+        void remove_at(int address); // Removes the breakpoint and every condition at address, or with -1 the conditions for any address.
+        void set_watch(u16 address, int length, u8 access); // An access of 0 removes the watch.
+
+        std::string execute(std::string const& command); // Runs one text command and returns the reply.
+        void collect_output(bool enabled) { keep_output = enabled; }
+        void log_to(std::ostream* stream) { log = stream; } // Where reports are written as well, cout unless the terminal display has the screen.
+        std::string take_output(); // Stop reports since the last call, for the debug console.
+};
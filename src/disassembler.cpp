@@ -0,0 +1,69 @@
+#include <iostream>
+#include <stdio.h>
+
+#include "disassembler.hpp"
+
+std::string disassemble(u16 op_code)
+{
+	char text[32];
+	unsigned int x = (op_code & 0x0F00) >> 8;
+	unsigned int y = (op_code & 0x00F0) >> 4;
+	unsigned int n = op_code & 0x000F;
+	unsigned int kk = op_code & 0x00FF;
+	unsigned int nnn = op_code & 0x0FFF;
+
+	snprintf(text, sizeof(text), "DW 0x%04X", op_code);
+
+	switch (op_code & 0xF000)
+	{
+		case (0x0000):
+			if (op_code == 0x00E0) snprintf(text, sizeof(text), "CLS");
+			if (op_code == 0x00EE) snprintf(text, sizeof(text), "RET");
+			break;
+		case (0x1000): snprintf(text, sizeof(text), "JP 0x%03X", nnn); break;
+		case (0x2000): snprintf(text, sizeof(text), "CALL 0x%03X", nnn); break;
+		case (0x3000): snprintf(text, sizeof(text), "SE V%X, 0x%02X", x, kk); break;
+		case (0x4000): snprintf(text, sizeof(text), "SNE V%X, 0x%02X", x, kk); break;
+		case (0x5000): snprintf(text, sizeof(text), "SE V%X, V%X", x, y); break;
+		case (0x6000): snprintf(text, sizeof(text), "LD V%X, 0x%02X", x, kk); break;
+		case (0x7000): snprintf(text, sizeof(text), "ADD V%X, 0x%02X", x, kk); break;
+		case (0x8000):
+			switch (n)
+			{
+				case (0x0): snprintf(text, sizeof(text), "LD V%X, V%X", x, y); break;
+				case (0x1): snprintf(text, sizeof(text), "OR V%X, V%X", x, y); break;
+				case (0x2): snprintf(text, sizeof(text), "AND V%X, V%X", x, y); break;
+				case (0x3): snprintf(text, sizeof(text), "XOR V%X, V%X", x, y); break;
+				case (0x4): snprintf(text, sizeof(text), "ADD V%X, V%X", x, y); break;
+				case (0x5): snprintf(text, sizeof(text), "SUB V%X, V%X", x, y); break;
+				case (0x6): snprintf(text, sizeof(text), "SHR V%X", x); break;
+				case (0x7): snprintf(text, sizeof(text), "SUBN V%X, V%X", x, y); break;
+				case (0xE): snprintf(text, sizeof(text), "SHL V%X", x); break;
+			}
+			break;
+		case (0x9000): snprintf(text, sizeof(text), "SNE V%X, V%X", x, y); break;
+		case (0xA000): snprintf(text, sizeof(text), "LD I, 0x%03X", nnn); break;
+		case (0xB000): snprintf(text, sizeof(text), "JP V0, 0x%03X", nnn); break;
+		case (0xC000): snprintf(text, sizeof(text), "RND V%X, 0x%02X", x, kk); break;
+		case (0xD000): snprintf(text, sizeof(text), "DRW V%X, V%X, %u", x, y, n); break;
+		case (0xE000):
+			if (kk == 0x9E) snprintf(text, sizeof(text), "SKP V%X", x);
+			if (kk == 0xA1) snprintf(text, sizeof(text), "SKNP V%X", x);
+			break;
+		case (0xF000):
+			switch (kk)
+			{
+				case (0x07): snprintf(text, sizeof(text), "LD V%X, DT", x); break;
+				case (0x0A): snprintf(text, sizeof(text), "LD V%X, K", x); break;
+				case (0x15): snprintf(text, sizeof(text), "LD DT, V%X", x); break;
+				case (0x18): snprintf(text, sizeof(text), "LD ST, V%X", x); break;
+				case (0x1E): snprintf(text, sizeof(text), "ADD I, V%X", x); break;
+				case (0x29): snprintf(text, sizeof(text), "LD F, V%X", x); break;
+				case (0x33): snprintf(text, sizeof(text), "LD B, V%X", x); break;
+				case (0x55): snprintf(text, sizeof(text), "LD [I], V%X", x); break;
+				case (0x65): snprintf(text, sizeof(text), "LD V%X, [I]", x); break;
+			}
+			break;
+	}
+	return text;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <string>
+
+#include "chip8.hpp"
+
+// Returns the op code in the assembly syntax of Cowgod's Chip-8 Technical Reference, e.g. "LD V1, 0x2A". Unknown op codes give "DW 0xXXXX".
+std::string disassemble(u16 op_code);
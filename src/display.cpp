@@ -31,12 +31,47 @@ void Display_and_input::begin_display(char const* file_title)
 }
 
 
+/*	Routes frames through a CPU post-processor. Its output is written straight in to a streaming texture of the upscaled size,
+	so SDL only has to do a final (much smaller) stretch to the window.	*/
+void Display_and_input::begin_post_process(Post_processor* processor)
+{
+	post_texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, processor->width(), processor->height());
+	if (!post_texture)
+	{
+		cout << "Couldn't create post-processing texture, showing the raw display.\n";
+		return;
+	}
+	post_processor = processor;
+}
+
+void Display_and_input::begin_hud(Hud* new_hud, u64 target_ips)
+{
+	if (new_hud->begin_hud(renderer, target_ips))
+		hud = new_hud;
+}
+
 void Display_and_input::update_display(void const* pixels, int pitch)
 {
 	
     SDL_RenderClear(renderer);	
-	SDL_UpdateTexture(texture, nullptr, pixels, pitch);		      
-	SDL_RenderCopy(renderer, texture, nullptr, nullptr);	
+	if (post_processor)
+	{
+		void* locked_pixels;
+		int locked_pitch;
+		if (SDL_LockTexture(post_texture, nullptr, &locked_pixels, &locked_pitch) == 0)
+		{
+			post_processor->process((u32 const*)pixels, (u32*)locked_pixels, locked_pitch);
+			SDL_UnlockTexture(post_texture);
+		}
+		SDL_RenderCopy(renderer, post_texture, nullptr, nullptr);
+	}
+	else
+	{
+		SDL_UpdateTexture(texture, nullptr, pixels, pitch);		      
+		SDL_RenderCopy(renderer, texture, nullptr, nullptr);	
+	}
+	if (hud && show_hud)
+		hud->draw(renderer);
 	SDL_RenderPresent(renderer);
 }
 
@@ -58,6 +93,31 @@ bool Display_and_input::get_key_press(u8* keys)
                             cout << "Terminating chip8 program.\n";
 							quit = true;
 						    break;
+						case SDLK_F1:
+							if (!event.key.repeat)
+								show_hud = !show_hud;
+						    break;
+						case SDLK_F5:
+							if (debugger && !event.key.repeat)
+							{
+								if (debugger->is_paused())
+									debugger->resume();
+								else
+									debugger->pause();
+							}
+						    break;
+						case SDLK_F9:
+							if (debugger && !event.key.repeat)
+								debugger->toggle_breakpoint_at_pc();
+						    break;
+						case SDLK_F10:
+							if (debugger)
+								debugger->step_over();
+						    break;
+						case SDLK_F11:
+							if (debugger)
+								debugger->step_into(1);
+						    break;
 						case SDLK_x:						
 							keys[0] = 1;                            
 						    break;
@@ -9,17 +9,27 @@
 #endif
 
 #include "chip8.hpp"
+#include "debugger.hpp"
+#include "hud.hpp"
+#include "post_process.hpp"
 
 class Display_and_input
 {
     public:
         Display_and_input() = default;
         void begin_display(char const* title);
+        void begin_post_process(Post_processor* processor);
+        void begin_hud(Hud* new_hud, u64 target_ips);
         void update_display(void const* pixels, int pitch);
         bool get_key_press(u8* keyboard_controls);
         bool quit = false;
+        bool show_hud = false; // Toggled with F1.
         SDL_Window* window;
         SDL_Renderer* renderer;
         SDL_Texture* texture;       
+        Post_processor* post_processor = nullptr;
+        SDL_Texture* post_texture = nullptr; // Streaming texture the size of the post-processed image.
+        Hud* hud = nullptr;
+        Debugger* debugger = nullptr; // When set, F5 continues or pauses, F9 toggles a breakpoint at PC, F10 steps over and F11 steps.
 };
 
@@ -0,0 +1,259 @@
+#include <iostream>
+#include <errno.h>
+#include <string.h>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "frame_stream.hpp"
+#include "unix_socket.hpp"
+
+static const u64 blank_frame[Y_RESOLUTION] {};
+
+Frame_stream::~Frame_stream()
+{
+	end_stream();
+}
+
+/*	Starts listening for viewers at path. See listen_on_unix_socket for what happens to an existing file there.	*/
+bool Frame_stream::begin_stream(char const* path)
+{
+	listen_fd = listen_on_unix_socket(path, MAX_VIEWERS, "stream");
+	if (listen_fd < 0)
+		return false;
+
+	socket_path = path;
+	viewers.reserve(MAX_VIEWERS);
+	poll_fds.reserve(MAX_VIEWERS + 1);
+	cout << "Streaming display on " << path << ".\n";
+	return true;
+}
+
+void Frame_stream::end_stream()
+{
+	for (Viewer& viewer : viewers)
+		close(viewer.fd);
+	viewers.clear();
+
+	if (listen_fd >= 0)
+	{
+		close(listen_fd);
+		unlink(socket_path.c_str());
+		listen_fd = -1;
+	}
+}
+
+/*	Does one round of socket work without blocking: accepts new viewers, applies any key events they sent,
+	and pushes out queued frames to viewers whose sockets have room. A single poll call covers every viewer.	*/
+void Frame_stream::service(u8* keyboard_controls)
+{
+	if (listen_fd < 0)
+		return;
+
+	poll_fds.clear();
+	poll_fds.push_back({listen_fd, POLLIN, 0});
+	for (Viewer const& viewer : viewers)
+	{
+		short events = POLLIN;
+		if (viewer.pending_sent < viewer.pending.size() || viewer.needs_keyframe)
+			events |= POLLOUT;
+		poll_fds.push_back({viewer.fd, events, 0});
+	}
+
+	if (poll(poll_fds.data(), poll_fds.size(), 0) <= 0)
+		return;
+
+	// Walk backwards so that dropping a viewer does not shift the ones still to be visited.
+	for (size_t i = viewers.size(); i-- > 0;)
+	{
+		short revents = poll_fds[i + 1].revents;
+		bool connected = !viewers[i].disconnected && !(revents & (POLLERR | POLLNVAL));
+
+		if (connected && (revents & (POLLIN | POLLHUP)))
+			connected = read_key_events(viewers[i], keyboard_controls);
+		if (connected && (revents & POLLOUT))
+			connected = flush(viewers[i]);
+
+		if (!connected)
+			drop_viewer(i, keyboard_controls);
+	}
+
+	if (poll_fds[0].revents & POLLIN)
+		accept_viewers();
+}
+
+/*	Sends the display to every viewer if it differs from the last published frame. The delta is encoded once and shared by all viewers.
+	Viewers that have gone away are only marked here, as their keys are released by service(), which has the keyboard.	*/
+void Frame_stream::publish(Chip8 const& chip8)
+{
+	if (listen_fd < 0)
+		return;
+
+	u64 frame[Y_RESOLUTION];
+	chip8.pack_display(frame);
+
+	if (memcmp(frame, last_frame, sizeof(frame)) == 0)
+		return;
+
+	++sequence;
+	encode(last_frame, frame, 'D', delta_message);
+	memcpy(last_frame, frame, sizeof(frame));
+	keyframe_ready = false;
+
+	for (Viewer& viewer : viewers)
+	{
+		if (viewer.disconnected)
+			continue;
+		queue(viewer, delta_message);
+		if (!flush(viewer))
+			viewer.disconnected = true;
+	}
+}
+
+void Frame_stream::accept_viewers()
+{
+	int fd;
+	while ((fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+	{
+		if (viewers.size() >= MAX_VIEWERS)
+		{
+			close(fd);
+			continue;
+		}
+
+		viewers.push_back({fd, {}, 0, true, {}, 0, 0, false});
+		if (!flush(viewers.back()))
+		{
+			close(fd);
+			viewers.pop_back();
+		}
+	}
+}
+
+/*	Reads every key event waiting on the viewer's socket. Returns false once the viewer has disconnected.	*/
+bool Frame_stream::read_key_events(Viewer& viewer, u8* keyboard_controls)
+{
+	u8 buffer[256];
+	while (true)
+	{
+		ssize_t received = recv(viewer.fd, buffer, sizeof(buffer), 0);
+		if (received == 0)
+			return false;
+		if (received < 0)
+			return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+
+		for (ssize_t i = 0; i < received; ++i)
+		{
+			viewer.key_event[viewer.key_event_length++] = buffer[i];
+			if (viewer.key_event_length == 2)
+			{
+				u8 key = viewer.key_event[0];
+				if (key < KEY_COUNT)
+				{
+					keyboard_controls[key] = viewer.key_event[1] ? 1 : 0;
+					if (viewer.key_event[1])
+						viewer.held_keys |= 1 << key;
+					else
+						viewer.held_keys &= ~(1 << key);
+				}
+				viewer.key_event_length = 0;
+			}
+		}
+	}
+}
+
+/*	Closes the viewer's socket and releases any keys it was still holding, as it can no longer send the releases itself.	*/
+void Frame_stream::drop_viewer(size_t index, u8* keyboard_controls)
+{
+	Viewer& viewer = viewers[index];
+	for (unsigned int key = 0; key < KEY_COUNT; ++key)
+		if (viewer.held_keys & (1 << key))
+			keyboard_controls[key] = 0;
+
+	close(viewer.fd);
+	viewers.erase(viewers.begin() + index);
+}
+
+/*	Queues a message unless the viewer is already waiting for a keyframe. If the viewer's backlog would grow too large,
+	it stops receiving deltas and gets a fresh keyframe once what it has queued has been sent.	*/
+void Frame_stream::queue(Viewer& viewer, std::vector<u8> const& message)
+{
+	if (viewer.needs_keyframe)
+		return;
+
+	if (viewer.pending.size() - viewer.pending_sent + message.size() > MAX_VIEWER_BACKLOG)
+	{
+		viewer.needs_keyframe = true;
+		return;
+	}
+	viewer.pending.insert(viewer.pending.end(), message.begin(), message.end());
+}
+
+/*	Sends as much of the viewer's queue as its socket will take. Returns false if the viewer has gone away.	*/
+bool Frame_stream::flush(Viewer& viewer)
+{
+	while (true)
+	{
+		if (viewer.pending_sent == viewer.pending.size())
+		{
+			viewer.pending.clear();
+			viewer.pending_sent = 0;
+			if (!viewer.needs_keyframe)
+				return true;
+
+			if (!keyframe_ready)
+			{
+				encode(blank_frame, last_frame, 'K', keyframe_message);
+				keyframe_ready = true;
+			}
+			viewer.pending = keyframe_message;
+			viewer.needs_keyframe = false;
+		}
+
+		ssize_t sent = send(viewer.fd, viewer.pending.data() + viewer.pending_sent, viewer.pending.size() - viewer.pending_sent, MSG_NOSIGNAL);
+		if (sent < 0)
+			return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+		viewer.pending_sent += sent;
+	}
+}
+
+/*	Encodes the pixels that differ between two packed frames. Each changed row is XORed against its previous state,
+	then written as alternating runs of unchanged and changed pixels. Unchanged rows cost nothing.	*/
+void Frame_stream::encode(u64 const* previous, u64 const* current, u8 type, std::vector<u8>& message) const
+{
+	message.clear();
+	message.push_back(type);
+	for (int i = 0; i < 4; ++i)
+		message.push_back((sequence >> (8 * i)) & 0xFF);
+	message.push_back(0); // Payload length, filled in below.
+	message.push_back(0);
+
+	for (unsigned int row = 0; row < Y_RESOLUTION; ++row)
+	{
+		u64 changed = previous[row] ^ current[row];
+		if (!changed)
+			continue;
+
+		message.push_back(row);
+		size_t run_count_index = message.size();
+		message.push_back(0);
+
+		u8 run_count = 0;
+		while (changed)
+		{
+			int unchanged_run = __builtin_clzll(changed);
+			changed <<= unchanged_run;
+			int changed_run = ~changed ? __builtin_clzll(~changed) : 64;
+			changed = changed_run < 64 ? changed << changed_run : 0;
+
+			message.push_back(unchanged_run);
+			message.push_back(changed_run);
+			run_count += 2;
+		}
+		message[run_count_index] = run_count;
+	}
+
+	size_t payload_length = message.size() - 7;
+	message[5] = payload_length & 0xFF;
+	message[6] = payload_length >> 8;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <poll.h>
+#include <string>
+#include <vector>
+
+#include "chip8.hpp"
+
+const unsigned int MAX_VIEWERS = 64;
+const unsigned int MAX_VIEWER_BACKLOG = 16384; // Bytes queued for a slow viewer before it stops getting deltas and is resynced with a keyframe.
+
+/*	Streams the display to any number of local viewers over a Unix domain socket, and accepts key events back.
+	Everything is non-blocking, so service() and publish() can be called from the emulation loop.
+
+	Server to viewer, multi-byte values are little-endian:
+		u8  type		'K' keyframe (changes against a blank display) or 'D' delta (changes against the previous frame)
+		u32 sequence	increases by one for every published frame
+		u16 length		number of payload bytes that follow
+		payload			for each changed row: u8 row, u8 run count, then that many u8 run lengths.
+						Runs alternate between unchanged and changed pixels, starting with unchanged, reading left to right.
+						A viewer flips (XORs) every pixel in a changed run. Trailing unchanged pixels are not sent.
+
+	Viewer to server, two bytes per key event:
+		u8 key (0x0 to 0xF), u8 state (1 pressed, 0 released)	*/
+
+struct Viewer
+{
+    int fd;
+    std::vector<u8> pending; // Whole messages queued for this viewer that the socket has not taken yet.
+    size_t pending_sent;
+    bool needs_keyframe; // Set for new viewers and for viewers that fell too far behind. Sent once pending has drained.
+    u8 key_event[2];
+    int key_event_length;
+    u16 held_keys; // A bit for each key this viewer has pressed and not released, so they can be released when it goes away.
+    bool disconnected; // Set when a send fails in publish(). The viewer is dropped by the next service().
+};
+
+class Frame_stream
+{
+    private:
+        int listen_fd = -1;
+        std::string socket_path;
+        std::vector<Viewer> viewers;
+        std::vector<pollfd> poll_fds;
+        u64 last_frame[Y_RESOLUTION] {};
+        u32 sequence {};
+        std::vector<u8> delta_message;
+        std::vector<u8> keyframe_message;
+        bool keyframe_ready = false;
+
+        void accept_viewers();
+        bool read_key_events(Viewer& viewer, u8* keyboard_controls);
+        void drop_viewer(size_t index, u8* keyboard_controls);
+        bool flush(Viewer& viewer);
+        void queue(Viewer& viewer, std::vector<u8> const& message);
+        void encode(u64 const* previous, u64 const* current, u8 type, std::vector<u8>& message) const;
+
+    public:
+        Frame_stream() = default;
+        ~Frame_stream();
+        bool begin_stream(char const* path);
+        void service(u8* keyboard_controls);
+        void publish(Chip8 const& chip8);
+        void end_stream();
+};
@@ -0,0 +1,166 @@
+#include <algorithm>
+#include <iostream>
+#include <stdio.h>
+
+#include "hud.hpp"
+
+const u32 HUD_BACKGROUND = 0xC0000000;
+const u32 HUD_TEXT = 0xFFFFFFFF;
+const u32 HUD_GRAPH = 0xFF40C060;
+const u32 HUD_GRAPH_LATE = 0xFFE04040; // Frames that took longer than the frame budget.
+const u32 HUD_GRAPH_BUDGET = 0xFF808080;
+const float FRAME_BUDGET_MS = 1000.0f / 60.0f;
+
+struct Glyph
+{
+	char character;
+	u8 rows[5];
+};
+
+// Letters the HUD needs that the hex font does not have. O and S reuse the 0 and 5 digits.
+static const Glyph extra_glyphs[] =
+{
+	{'G', {0xF0, 0x80, 0xB0, 0x90, 0xF0}},
+	{'I', {0xE0, 0x40, 0x40, 0x40, 0xE0}},
+	{'M', {0x90, 0xF0, 0xF0, 0x90, 0x90}},
+	{'P', {0xF0, 0x90, 0xF0, 0x80, 0x80}},
+	{'R', {0xE0, 0x90, 0xE0, 0xA0, 0x90}},
+	{'T', {0xF0, 0x40, 0x40, 0x40, 0x40}},
+	{'U', {0x90, 0x90, 0x90, 0x90, 0xF0}},
+	{'V', {0x90, 0x90, 0x90, 0x60, 0x60}},
+	{'X', {0x90, 0x90, 0x60, 0x90, 0x90}},
+	{'/', {0x10, 0x10, 0x20, 0x40, 0x40}},
+	{'.', {0x00, 0x00, 0x00, 0x00, 0x40}},
+};
+
+/*	Returns the 5 rows of a character's sprite (the high nibble of each byte), or nullptr for a blank.	*/
+static u8 const* glyph_rows(char character)
+{
+	if (character >= '0' && character <= '9')
+		return font + 5 * (character - '0');
+	if (character >= 'A' && character <= 'F')
+		return font + 5 * (character - 'A' + 10);
+	if (character == 'O')
+		return font;
+	if (character == 'S')
+		return font + 5 * 5;
+
+	for (Glyph const& glyph : extra_glyphs)
+		if (glyph.character == character)
+			return glyph.rows;
+	return nullptr;
+}
+
+bool Hud::begin_hud(SDL_Renderer* renderer, u64 target_ips)
+{
+	texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, HUD_WIDTH, HUD_HEIGHT);
+	if (!texture)
+	{
+		cout << "Couldn't create HUD texture.\n";
+		return false;
+	}
+	SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+	target_instructions_per_second = target_ips;
+	return true;
+}
+
+/*	Called once per presented frame, whether or not the HUD is showing, so the numbers are already right when it is turned on.
+	A frame that ran no instructions showed the same emulated state again, so it counts as duplicated.	*/
+void Hud::record_frame(float frame_time_ms, int instructions, int frames_dropped, u32 now_ms)
+{
+	frame_times_ms[next_frame_time] = frame_time_ms;
+	next_frame_time = (next_frame_time + 1) % FRAME_TIME_SAMPLES;
+
+	dropped_frames += frames_dropped;
+	if (instructions == 0)
+		++duplicated_frames;
+
+	instructions_this_second += instructions;
+	if (now_ms - second_start_ms >= 1000)
+	{
+		instructions_per_second = instructions_this_second * 1000 / (now_ms - second_start_ms);
+		instructions_this_second = 0;
+		second_start_ms = now_ms;
+	}
+}
+
+/*	Redraws the HUD texture if it has not been redrawn in the last HUD_REDRAW_INTERVAL_MS.	*/
+void Hud::update(Chip8 const& chip8, u32 now_ms)
+{
+	if (!texture || now_ms - last_redraw_ms < HUD_REDRAW_INTERVAL_MS)
+		return;
+
+	last_redraw_ms = now_ms;
+	redraw(chip8);
+	SDL_UpdateTexture(texture, nullptr, pixels, HUD_WIDTH * sizeof(pixels[0]));
+}
+
+void Hud::draw(SDL_Renderer* renderer) const
+{
+	if (!texture)
+		return;
+
+	SDL_Rect destination {0, 0, HUD_WIDTH * HUD_SCALE, HUD_HEIGHT * HUD_SCALE};
+	SDL_RenderCopy(renderer, texture, nullptr, &destination);
+}
+
+void Hud::draw_text(int x, int y, char const* text, u32 colour)
+{
+	for (; *text; ++text, x += 5)
+	{
+		u8 const* rows = glyph_rows(*text);
+		if (!rows)
+			continue;
+
+		for (int row = 0; row < 5; ++row)
+			for (int column = 0; column < 4; ++column)
+				if (rows[row] & (0x80 >> column) && x + column < HUD_WIDTH && y + row < HUD_HEIGHT)
+					pixels[(y + row) * HUD_WIDTH + x + column] = colour;
+	}
+}
+
+/*	One column per recorded frame, oldest on the left. The grey line is the 60 fps budget and the graph tops out at twice that.	*/
+void Hud::draw_frame_time_graph(int x, int y, int height)
+{
+	int budget_row = y + height / 2;
+	for (int i = 0; i < FRAME_TIME_SAMPLES; ++i)
+		pixels[budget_row * HUD_WIDTH + x + i] = HUD_GRAPH_BUDGET;
+
+	for (int i = 0; i < FRAME_TIME_SAMPLES; ++i)
+	{
+		float frame_time = frame_times_ms[(next_frame_time + i) % FRAME_TIME_SAMPLES];
+		int bar = std::min(height, (int)(frame_time / (2 * FRAME_BUDGET_MS) * height + 0.5f));
+		u32 colour = frame_time > FRAME_BUDGET_MS ? HUD_GRAPH_LATE : HUD_GRAPH;
+		for (int row = 0; row < bar; ++row)
+			pixels[(y + height - 1 - row) * HUD_WIDTH + x + i] = colour;
+	}
+}
+
+void Hud::redraw(Chip8 const& chip8)
+{
+	std::fill_n(pixels, HUD_WIDTH * HUD_HEIGHT, HUD_BACKGROUND);
+
+	char line[32];
+	float slowest = *std::max_element(frame_times_ms, frame_times_ms + FRAME_TIME_SAMPLES);
+
+	snprintf(line, sizeof(line), "IPS %llu/%llu", (unsigned long long)instructions_per_second, (unsigned long long)target_instructions_per_second);
+	draw_text(2, 2, line, HUD_TEXT);
+	snprintf(line, sizeof(line), "FT MAX %.1f MS", slowest);
+	draw_text(2, 9, line, HUD_TEXT);
+	draw_frame_time_graph(2, 16, 20);
+	snprintf(line, sizeof(line), "DROP %llu DUP %llu", (unsigned long long)dropped_frames, (unsigned long long)duplicated_frames);
+	draw_text(2, 38, line, HUD_TEXT);
+	snprintf(line, sizeof(line), "DT %02X ST %02X", chip8.delay_timer, chip8.get_sound_timer());
+	draw_text(2, 45, line, HUD_TEXT);
+	snprintf(line, sizeof(line), "PC %04X OP %04X", chip8.get_program_counter(), chip8.op_code_at(chip8.get_program_counter()));
+	draw_text(2, 52, line, HUD_TEXT);
+
+	u8 const* V = chip8.get_V_registers();
+	for (int half = 0; half < 2; ++half)
+	{
+		int n = snprintf(line, sizeof(line), "V%X", half * 8);
+		for (int i = 0; i < 8; ++i)
+			n += snprintf(line + n, sizeof(line) - n, " %02X", V[half * 8 + i]);
+		draw_text(1, 59 + half * 7, line, HUD_TEXT);
+	}
+}
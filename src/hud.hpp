@@ -0,0 +1,48 @@
+#pragma once
+
+#ifdef _WIN32
+#include "SDL2\include\SDL2\SDL.h"
+#endif
+
+#ifdef __linux__
+#include <SDL2/SDL.h>
+#endif
+
+#include "chip8.hpp"
+
+const int HUD_WIDTH = 136;
+const int HUD_HEIGHT = 78;
+const int HUD_SCALE = 3;                // The HUD texture is drawn at this many window pixels per HUD pixel.
+const u32 HUD_REDRAW_INTERVAL_MS = 250; // The HUD texture is redrawn at most this often, however fast frames are presented.
+const int FRAME_TIME_SAMPLES = 120;     // Two seconds of frame times at 60 fps.
+
+/*	Performance and debug overlay. Per-frame bookkeeping (record_frame) is a handful of adds, and the text and graph are only
+	redrawn in to their own small texture a few times a second, so showing the HUD does not slow emulation down.
+	Text is drawn with the CHIP-8 hex font, plus a few extra letters in the same 4x5 style.	*/
+class Hud
+{
+    private:
+        SDL_Texture* texture = nullptr;
+        u32 pixels[HUD_WIDTH * HUD_HEIGHT] {};
+        u32 last_redraw_ms {};
+
+        float frame_times_ms[FRAME_TIME_SAMPLES] {};
+        int next_frame_time {};
+        u64 dropped_frames {};
+        u64 duplicated_frames {};
+        u64 instructions_this_second {};
+        u32 second_start_ms {};
+        u64 instructions_per_second {};
+        u64 target_instructions_per_second {};
+
+        void draw_text(int x, int y, char const* text, u32 colour);
+        void draw_frame_time_graph(int x, int y, int height);
+        void redraw(Chip8 const& chip8);
+
+    public:
+        Hud() = default;
+        bool begin_hud(SDL_Renderer* renderer, u64 target_ips);
+        void record_frame(float frame_time_ms, int instructions, int frames_dropped, u32 now_ms);
+        void update(Chip8 const& chip8, u32 now_ms);
+        void draw(SDL_Renderer* renderer) const;
+};
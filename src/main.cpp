@@ -1,6 +1,11 @@
 /* A chip-8 interpreter by CJW	*/
 
+#include <algorithm>
+#include <fstream>
 #include <iostream>
+#include <sstream>
+#include <stdio.h>
+#include <string.h>
 
 #ifdef _WIN32
 #include "SDL2\include\SDL2\SDL.h"
@@ -12,17 +17,104 @@
 
 #include "chip8.hpp"
 #include "display.hpp"
+#include "profiler.hpp"
+
+#ifdef __linux__
+#include "debug_console.hpp"
+#include "frame_stream.hpp"
+#include "shared_display.hpp"
+#include "terminal_display.hpp"
+#endif
+
+const u64 DEFAULT_INSTRUCTIONS_PER_SECOND = 700;
+const unsigned int FRAME_RATE = 60;
+const int MAX_RUN_AHEAD_FRAMES = 8;
 
 int main(int argc, char** argv)
 {
     Chip8 chip8{}; 
     Display_and_input display_and_input;    
 
+    if (argc < 2)
+    {
+        cout << "Usage: chip8 <rom> [--ips <n>] [--run-ahead <frames>] [--profile <output prefix>] [--debug] [--debug-socket <socket path>] [--terminal [--braille]] [--stream <socket path>] [--shm <name> [--shm-events]] [--crt] [--scale <n>] [--persistence <0-255>] [--palette <off RRGGBB>,<on RRGGBB>]\n";
+        return 0;
+    }
+
     char const* file_name = argv[1];    
-    char const* yeet = argv[2];    
+    char const* stream_path = nullptr;
+    char const* shared_memory_name = nullptr;
+    char const* debug_socket_path = nullptr;
+    bool debug = false;
+    bool terminal = false;
+    bool braille = false;
+    bool frame_events = false;
+    bool crt = false;
+    std::string profile_prefix;
+    u64 instructions_per_second = DEFAULT_INSTRUCTIONS_PER_SECOND;
+    int run_ahead_frames = 0;
+    Post_process_settings post_process_settings;
+
+    for (int i = 2; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--stream") == 0 && i + 1 < argc)
+            stream_path = argv[++i];
+        else if (strcmp(argv[i], "--shm") == 0 && i + 1 < argc)
+            shared_memory_name = argv[++i];
+        else if (strcmp(argv[i], "--shm-events") == 0)
+            frame_events = true;
+        else if (strcmp(argv[i], "--ips") == 0 && i + 1 < argc)
+            instructions_per_second = std::max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--run-ahead") == 0 && i + 1 < argc)
+            run_ahead_frames = std::min(MAX_RUN_AHEAD_FRAMES, std::max(0, atoi(argv[++i])));
+        else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc)
+            profile_prefix = argv[++i];
+        else if (strcmp(argv[i], "--debug") == 0)
+            debug = true;
+        else if (strcmp(argv[i], "--debug-socket") == 0 && i + 1 < argc)
+        {
+            debug_socket_path = argv[++i];
+            debug = true;
+        }
+        else if (strcmp(argv[i], "--terminal") == 0)
+            terminal = true;
+        else if (strcmp(argv[i], "--braille") == 0)
+            terminal = braille = true;
+        else if (strcmp(argv[i], "--crt") == 0)
+            crt = true;
+        else if (strcmp(argv[i], "--scale") == 0 && i + 1 < argc)
+            post_process_settings.scale = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--persistence") == 0 && i + 1 < argc)
+            post_process_settings.persistence = std::min(255, std::max(0, atoi(argv[++i])));
+        else if (strcmp(argv[i], "--palette") == 0 && i + 1 < argc)
+        {
+            unsigned int off, on;
+            if (sscanf(argv[++i], "%x,%x", &off, &on) == 2)
+            {
+                post_process_settings.off_colour = 0xFF000000 | off;
+                post_process_settings.on_colour = 0xFF000000 | on;
+            }
+            else
+                cout << "Palette should look like 101810,40FF60.\n";
+        }
+        else
+            cout << "Ignoring unknown option " << argv[i] << ".\n";
+    }
+
+#ifndef __linux__
+    terminal = false; // The terminal display needs termios.
+#endif
 
     chip8.clear_all();
-    display_and_input.begin_display(file_name);
+    if (!terminal)
+        display_and_input.begin_display(file_name);
+
+    Post_processor post_processor;
+    if (crt && !terminal)
+    {
+        post_processor.configure(post_process_settings);
+        display_and_input.begin_post_process(&post_processor);
+    }
     
     if (!chip8.load_file(file_name))
         {
@@ -30,30 +122,160 @@ int main(int argc, char** argv)
             return 0;        
         }
    
+#ifdef __linux__
+    Frame_stream frame_stream;
+    if (stream_path)
+        frame_stream.begin_stream(stream_path);
+
+    Shared_display_writer shared_display;
+    if (shared_memory_name)
+        shared_display.begin_shared_display(shared_memory_name, frame_events);
+#endif
+
     int video_pitch = sizeof(chip8.display_array[0]) * X_RESOLUTION; // the pitch is the length of a row of pixels in bytes    
     
-    //cycle will run a single cycle of fetching the instruction from memory at the current program counter, process the instruction, 
-    //then execute the instruction and update the display.Constantly checking for keyboard inputs and will close the program if 
-    // end_program equates to true, from pressing the escape key.    
-    
+    //Each frame runs the instructions owed at the target instructions per second, then updates the display. Constantly checking 
+    //for keyboard inputs and will close the program if end_program equates to true, from pressing the escape key.
+    //Frames are paced to FRAME_RATE. If a frame finishes after the next one was due, the missed frames are counted as dropped
+    //and skipped rather than run back to back.
+    //With run ahead, a copy of the machine is run a few more frames with the keys held now and that copy is what gets shown, 
+    //hiding the frames a rom takes to react to a key. The copy is thrown away, so the real machine never sees the future.
+
+    Profiler profiler;
+    if (!profile_prefix.empty())
+        chip8.attach_profiler(&profiler);
+
+    Chip8 run_ahead{};
+
+    Debugger debugger;
+    std::ostringstream debug_log; // With the terminal display, reports go here and then to its status line rather than to cout.
+    if (terminal)
+        debugger.log_to(&debug_log);
+    if (debug)
+    {
+        debugger.begin_debugger(&chip8, true);
+        if (!terminal)
+            display_and_input.debugger = &debugger;
+    }
+#ifdef __linux__
+    Debug_console debug_console;
+    if (debug_socket_path)
+        debug_console.begin_console(debug_socket_path, debugger);
+
+    //The terminal display is started after everything else that prints, as text written once it has the screen would sit on
+    //cells that are never redrawn.
+    Terminal_display terminal_display;
+    if (terminal)
+    {
+        if (!terminal_display.begin_display(file_name, braille))
+            return 0;
+        if (debug)
+            terminal_display.debugger = &debugger;
+    }
+#endif
+
+    Hud hud;
+    if (!terminal)
+        display_and_input.begin_hud(&hud, instructions_per_second);
+
+    const Uint64 counter_frequency = SDL_GetPerformanceFrequency();
+    const Uint64 frame_ticks = counter_frequency / FRAME_RATE;
+    Uint64 next_frame = SDL_GetPerformanceCounter() + frame_ticks;
+    double instructions_owed = 0;
     bool end_program = false; 
-    int count = 0;    
 
     while(!end_program)
     {      
-        end_program = display_and_input.get_key_press(chip8.keyboard_controls); 
-        count++;         
-        if (count > 10000)
-        {               
-		    chip8.cycle();           
-            display_and_input.update_display(chip8.display_array, video_pitch); 
-            display_and_input.get_key_press(chip8.keyboard_controls);  
-            count = 0;                           
-        }              
-        
-        //SDL_Delay(2000);  
-        //display_and_input.get_key_press(chip8.keyboard_controls);    
-    }    
+        Uint64 frame_start = SDL_GetPerformanceCounter();
+#ifdef __linux__
+        if (terminal)
+            end_program = terminal_display.get_key_press(chip8.keyboard_controls, SDL_GetTicks());
+        else
+#endif
+            end_program = display_and_input.get_key_press(chip8.keyboard_controls); 
+
+        int instructions = 0;
+        instructions_owed += (double)instructions_per_second / FRAME_RATE;
+        if (debugger.active())
+        {
+            //Only taken while something is being debugged, so the loop below is the same as without a debugger.
+            instructions = debugger.run((int)instructions_owed);
+            instructions_owed = debugger.is_paused() ? 0 : instructions_owed - instructions;
+        }
+        else
+        {
+            while (instructions_owed >= 1)
+            {
+                int executed = chip8.cycle();
+                instructions += executed;
+                instructions_owed -= executed;
+            }
+        }
+
+        Chip8 const* presented = &chip8;
+        if (run_ahead_frames > 0 && !debugger.active())
+        {
+            run_ahead = chip8;
+            run_ahead.detach_profiler();
+            double run_ahead_owed = instructions_owed;
+            for (int frame = 0; frame < run_ahead_frames; ++frame)
+            {
+                run_ahead_owed += (double)instructions_per_second / FRAME_RATE;
+                while (run_ahead_owed >= 1)
+                    run_ahead_owed -= run_ahead.cycle();
+            }
+            presented = &run_ahead;
+        }
+
+#ifdef __linux__
+        if (terminal && !debug_log.str().empty())
+        {
+            std::string reports = debug_log.str();
+            reports.pop_back();
+            terminal_display.show_status(reports.substr(reports.find_last_of('\n') + 1));
+            debug_log.str("");
+        }
+        if (terminal)
+            terminal_display.update_display(*presented, SDL_GetTicks());
+        else
+#endif
+        {
+            if (display_and_input.show_hud)
+                hud.update(chip8, SDL_GetTicks());
+            display_and_input.update_display(presented->display_array, video_pitch); 
+        }
+#ifdef __linux__
+        frame_stream.publish(*presented);
+        frame_stream.service(chip8.keyboard_controls);
+        shared_display.publish(*presented);
+        debug_console.service(debugger);
+#endif
+
+        Uint64 now = SDL_GetPerformanceCounter();
+        int frames_dropped = 0;
+        if (now < next_frame)
+            SDL_Delay((next_frame - now) * 1000 / counter_frequency);
+        else
+        {
+            frames_dropped = (now - next_frame) / frame_ticks;
+            next_frame += frames_dropped * frame_ticks;
+        }
+        next_frame += frame_ticks;
+
+        hud.record_frame((now - frame_start) * 1000.0f / counter_frequency, instructions, frames_dropped, SDL_GetTicks());
+    }
+
+#ifdef __linux__
+    terminal_display.end_display(); // Back to the normal screen, so the messages below can be seen.
+#endif
+    if (!profile_prefix.empty())
+    {
+        std::ofstream disassembly(profile_prefix + ".asm");
+        profiler.write_disassembly(chip8, disassembly);
+        std::ofstream folded_stacks(profile_prefix + ".folded");
+        profiler.write_folded_stacks(folded_stacks);
+        cout << "Profile written to " << profile_prefix << ".asm and " << profile_prefix << ".folded.\n";
+    }
     return 0;
 }
 
@@ -0,0 +1,191 @@
+#include <algorithm>
+#include <iostream>
+#include <string.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "post_process.hpp"
+
+const int ROW_PADDING = 8; // expand_row writes whole vectors, so it can run up to 7 pixels past the end of a row.
+
+/*	Builds the palette and the weight rows for the chosen settings. Everything that depends only on the settings is worked out here,
+	so that process() does nothing but per-pixel arithmetic.	*/
+void Post_processor::configure(Post_process_settings const& new_settings)
+{
+	settings = new_settings;
+	settings.scale = std::max(1, settings.scale);
+
+	// Blend each channel from off_colour to on_colour by intensity.
+	for (int i = 0; i < 256; ++i)
+	{
+		u32 colour = 0xFF000000;
+		for (int shift = 0; shift < 24; shift += 8)
+		{
+			int off = (settings.off_colour >> shift) & 0xFF;
+			int on = (settings.on_colour >> shift) & 0xFF;
+			colour |= (u32)(off + (on - off) * i / 255) << shift;
+		}
+		palette[i] = colour;
+	}
+
+	int out_width = width();
+	expanded_row.assign(out_width + ROW_PADDING, 0);
+	mask_weights.assign(out_width * 4, 256);
+	scanline_weights.assign(out_width * 4, 256);
+
+	// An aperture grille: each output column favours one of blue, green or red (byte 0, 1, 2 of ARGB8888) in turn.
+	// Alpha (byte 3) is always left alone.
+	for (int x = 0; x < out_width; ++x)
+		for (int channel = 0; channel < 3; ++channel)
+		{
+			u16 weight = (x % 3 == channel) ? 256 : settings.mask + 1;
+			mask_weights[x * 4 + channel] = weight;
+			scanline_weights[x * 4 + channel] = weight * (settings.scanline + 1) / 256;
+		}
+}
+
+/*	Fades every pixel's intensity by persistence, then lights it fully if the pixel is on in the new frame:
+	intensity = max(on ? 255 : 0, intensity * persistence / 256)	*/
+void Post_processor::decay(u32 const* display_array)
+{
+	int i = 0;
+	const int count = X_RESOLUTION * Y_RESOLUTION;
+
+#if defined(__AVX2__)
+	const __m256i persistence = _mm256_set1_epi16(settings.persistence);
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i lane_order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+	for (; i + 32 <= count; i += 32)
+	{
+		// Pixels are 0 or 0xFFFFFFFF, so signed saturating packs turn 32 of them in to 32 bytes of 0 or 0xFF.
+		// The AVX2 packs work within each 128-bit lane, which the permute puts back in order.
+		__m256i a = _mm256_loadu_si256((__m256i const*)(display_array + i));
+		__m256i b = _mm256_loadu_si256((__m256i const*)(display_array + i + 8));
+		__m256i c = _mm256_loadu_si256((__m256i const*)(display_array + i + 16));
+		__m256i d = _mm256_loadu_si256((__m256i const*)(display_array + i + 24));
+		__m256i lit = _mm256_packs_epi16(_mm256_packs_epi32(a, b), _mm256_packs_epi32(c, d));
+		lit = _mm256_permutevar8x32_epi32(lit, lane_order);
+
+		__m256i current = _mm256_load_si256((__m256i const*)(intensity + i));
+		__m256i low = _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(current, zero), persistence), 8);
+		__m256i high = _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(current, zero), persistence), 8);
+		__m256i faded = _mm256_packus_epi16(low, high);
+
+		_mm256_store_si256((__m256i*)(intensity + i), _mm256_max_epu8(faded, lit));
+	}
+#elif defined(__SSE2__)
+	const __m128i persistence = _mm_set1_epi16(settings.persistence);
+	const __m128i zero = _mm_setzero_si128();
+	for (; i + 16 <= count; i += 16)
+	{
+		// Pixels are 0 or 0xFFFFFFFF, so signed saturating packs turn 16 of them in to 16 bytes of 0 or 0xFF.
+		__m128i a = _mm_loadu_si128((__m128i const*)(display_array + i));
+		__m128i b = _mm_loadu_si128((__m128i const*)(display_array + i + 4));
+		__m128i c = _mm_loadu_si128((__m128i const*)(display_array + i + 8));
+		__m128i d = _mm_loadu_si128((__m128i const*)(display_array + i + 12));
+		__m128i lit = _mm_packs_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+
+		__m128i current = _mm_load_si128((__m128i const*)(intensity + i));
+		__m128i low = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(current, zero), persistence), 8);
+		__m128i high = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(current, zero), persistence), 8);
+		__m128i faded = _mm_packus_epi16(low, high);
+
+		_mm_store_si128((__m128i*)(intensity + i), _mm_max_epu8(faded, lit));
+	}
+#endif
+
+	for (; i < count; ++i)
+	{
+		u8 faded = (intensity[i] * settings.persistence) >> 8;
+		intensity[i] = display_array[i] ? 255 : faded;
+	}
+}
+
+/*	Looks up the colour of each pixel in a display row and repeats it scale times across expanded_row.	*/
+void Post_processor::expand_row(int row)
+{
+	u32* out = expanded_row.data();
+	u8 const* source = intensity + row * X_RESOLUTION;
+	const int scale = settings.scale;
+
+	for (unsigned int x = 0; x < X_RESOLUTION; ++x, out += scale)
+	{
+		u32 colour = palette[source[x]];
+#if defined(__AVX2__)
+		__m256i repeated = _mm256_set1_epi32(colour);
+		for (int k = 0; k < scale; k += 8)
+			_mm256_storeu_si256((__m256i*)(out + k), repeated);
+#elif defined(__SSE2__)
+		__m128i repeated = _mm_set1_epi32(colour);
+		for (int k = 0; k < scale; k += 4)
+			_mm_storeu_si128((__m128i*)(out + k), repeated);
+#else
+		for (int k = 0; k < scale; ++k)
+			out[k] = colour;
+#endif
+	}
+}
+
+/*	out = expanded_row * weights / 256, channel by channel.	*/
+void Post_processor::apply_weights(u16 const* weights, u32* out) const
+{
+	int x = 0;
+	const int out_width = width();
+	u32 const* in = expanded_row.data();
+
+#if defined(__AVX2__)
+	const __m256i zero = _mm256_setzero_si256();
+	for (; x + 8 <= out_width; x += 8)
+	{
+		__m256i pixels = _mm256_loadu_si256((__m256i const*)(in + x));
+		// unpacklo/hi take pixels 0-1 and 4-5 / 2-3 and 6-7, so the weights are loaded to match.
+		__m256i weight_low = _mm256_permute2x128_si256(_mm256_loadu_si256((__m256i const*)(weights + x * 4)),
+		                                               _mm256_loadu_si256((__m256i const*)(weights + x * 4 + 16)), 0x20);
+		__m256i weight_high = _mm256_permute2x128_si256(_mm256_loadu_si256((__m256i const*)(weights + x * 4)),
+		                                                _mm256_loadu_si256((__m256i const*)(weights + x * 4 + 16)), 0x31);
+		__m256i low = _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(pixels, zero), weight_low), 8);
+		__m256i high = _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(pixels, zero), weight_high), 8);
+		_mm256_storeu_si256((__m256i*)(out + x), _mm256_packus_epi16(low, high));
+	}
+#elif defined(__SSE2__)
+	const __m128i zero = _mm_setzero_si128();
+	for (; x + 4 <= out_width; x += 4)
+	{
+		__m128i pixels = _mm_loadu_si128((__m128i const*)(in + x));
+		__m128i weight_low = _mm_loadu_si128((__m128i const*)(weights + x * 4));
+		__m128i weight_high = _mm_loadu_si128((__m128i const*)(weights + x * 4 + 8));
+		__m128i low = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(pixels, zero), weight_low), 8);
+		__m128i high = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(pixels, zero), weight_high), 8);
+		_mm_storeu_si128((__m128i*)(out + x), _mm_packus_epi16(low, high));
+	}
+#endif
+
+	for (; x < out_width; ++x)
+	{
+		u32 pixel = 0;
+		for (int channel = 0; channel < 4; ++channel)
+			pixel |= (((in[x] >> (8 * channel)) & 0xFF) * weights[x * 4 + channel] >> 8) << (8 * channel);
+		out[x] = pixel;
+	}
+}
+
+/*	Writes one post-processed frame of width() x height() ARGB8888 pixels to out. out_pitch is in bytes, as SDL_LockTexture gives it.	*/
+void Post_processor::process(u32 const* display_array, u32* out, int out_pitch)
+{
+	decay(display_array);
+
+	const int scale = settings.scale;
+	for (unsigned int row = 0; row < Y_RESOLUTION; ++row)
+	{
+		expand_row(row);
+		for (int k = 0; k < scale; ++k)
+		{
+			// Only draw scanlines when a block is tall enough to keep some of its rows bright.
+			bool scanline = scale >= 3 && k == scale - 1;
+			u32* out_row = (u32*)((u8*)out + (row * scale + k) * out_pitch);
+			apply_weights(scanline ? scanline_weights.data() : mask_weights.data(), out_row);
+		}
+	}
+}
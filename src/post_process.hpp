@@ -0,0 +1,40 @@
+#pragma once
+
+#include <vector>
+
+#include "chip8.hpp"
+
+struct Post_process_settings
+{
+    int scale = 10;               // Each CHIP-8 pixel becomes a scale x scale block.
+    u8 persistence = 200;         // How much of a pixel's brightness survives each frame, out of 256. 0 turns phosphor decay off.
+    u32 off_colour = 0xFF101810;  // ARGB8888
+    u32 on_colour = 0xFF40FF60;
+    u8 scanline = 150;            // Brightness of the last row of each block, out of 255. 255 turns scanlines off.
+    u8 mask = 190;                // Brightness of the two dimmed channels in each RGB triad of the aperture mask. 255 turns the mask off.
+};
+
+/*	Turns the raw 64x32 display in to a larger image on the CPU: phosphor decay over recent frames (which hides most of the flicker
+	from sprites being XORed off and back on), a palette, then an integer upscale with scanlines and an aperture mask.
+	The per-pixel work uses AVX2 or SSE2 when the compiler targets them, with a scalar fallback.	*/
+class Post_processor
+{
+    private:
+        Post_process_settings settings;
+        alignas(32) u8 intensity[X_RESOLUTION * Y_RESOLUTION] {};
+        u32 palette[256] {};
+        std::vector<u32> expanded_row;
+        std::vector<u16> mask_weights;     // Per output pixel, four u16 channel weights out of 256.
+        std::vector<u16> scanline_weights;
+
+        void decay(u32 const* display_array);
+        void expand_row(int row);
+        void apply_weights(u16 const* weights, u32* out) const;
+
+    public:
+        Post_processor() = default;
+        void configure(Post_process_settings const& new_settings);
+        int width() const { return X_RESOLUTION * settings.scale; }
+        int height() const { return Y_RESOLUTION * settings.scale; }
+        void process(u32 const* display_array, u32* out, int out_pitch);
+};
@@ -0,0 +1,54 @@
+#include <iomanip>
+#include <iostream>
+#include <stdio.h>
+#include <string>
+
+#include "disassembler.hpp"
+#include "profiler.hpp"
+
+const unsigned int PROFILE_START_ADDRESS = 0x200;
+
+/*	Writes memory from 0x200 as one op code per line, with how many times each address was executed and its share of the total.
+	The listing stops after the last address that is non-zero or was executed. Odd addresses only get a line of their own if
+	something jumped to them. An op code at 0xFFF takes its low byte from 0x000, as an instruction fetch there would.	*/
+void Profiler::write_disassembly(Chip8 const& chip8, std::ostream& out) const
+{
+	unsigned int end = PROFILE_START_ADDRESS;
+	for (unsigned int address = PROFILE_START_ADDRESS; address < MEMORY_SIZE; ++address)
+		if (address_hits[address] || chip8.read_memory(address))
+			end = address + 1;
+
+	char line[96];
+	out << "; address  op code  executions   share    instruction\n";
+	for (unsigned int address = PROFILE_START_ADDRESS; address < end; ++address)
+	{
+		if (address % 2 && !address_hits[address])
+			continue;
+
+		u16 op_code = chip8.op_code_at(address);
+		double share = total_instructions ? 100.0 * address_hits[address] / total_instructions : 0;
+		snprintf(line, sizeof(line), "  0x%03X    %04X    %10llu  %6.2f%%   %s\n", address, op_code,
+		         (unsigned long long)address_hits[address], share, disassemble(op_code).c_str());
+		out << line;
+	}
+}
+
+/*	Writes one line per call stack that executed anything, in the folded format read by flamegraph.pl and similar tools:
+	"main;sub_2B6;sub_334 1234".	*/
+void Profiler::write_folded_stacks(std::ostream& out) const
+{
+	for (u32 node = 0; node < nodes.size(); ++node)
+	{
+		if (!nodes[node].instructions)
+			continue;
+
+		std::string stack;
+		char frame[16];
+		for (u32 n = node; n != 0; n = nodes[n].parent)
+		{
+			snprintf(frame, sizeof(frame), ";sub_%03X", nodes[n].subroutine);
+			stack.insert(0, frame);
+		}
+		out << "main" << stack << ' ' << nodes[node].instructions << '\n';
+	}
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+#include "chip8.hpp"
+
+/*	A node in the tree of call stacks seen so far. Node 0 is the top level of the program (no 2nnn calls).	*/
+struct Call_stack_node
+{
+    u16 subroutine; // The address the 2nnn that entered this node called.
+    u32 parent;
+    u64 instructions; // Instructions executed while this was the whole call stack.
+};
+
+/*	Counts instructions per address and per call stack. While attached, each instruction costs two array increments;
+	calls and returns also look up or add a node in the call stack tree. The counting is all inline here, so code that
+	never attaches a profiler (the corpus runner, chip8_env) does not need to link profiler.cpp.	*/
+class Profiler
+{
+    private:
+        u64 address_hits[MEMORY_SIZE] {};
+        u64 total_instructions {};
+        std::vector<Call_stack_node> nodes {{0, 0, 0}};
+        std::unordered_map<u64, u32> children; // (parent << 16 | subroutine) to node.
+        u32 current_node {};
+        u32 depth {}; // Calls nested deeper than the stack are counted against the deepest node, so recursion cannot grow the tree.
+
+    public:
+        Profiler() = default;
+
+        // The program counter can run past 0xFFF (e.g. Bnnn), and fetches wrap like Paged_memory::read, so the count does too.
+        void record(u16 address)
+        {
+            ++address_hits[address & (MEMORY_SIZE - 1)];
+            ++nodes[current_node].instructions;
+            ++total_instructions;
+        }
+        void enter_subroutine(u16 subroutine)
+        {
+            if (depth == STACK_COUNT)
+                return;
+            ++depth;
+            u64 key = ((u64)current_node << 16) | subroutine;
+            auto child = children.find(key);
+            if (child == children.end())
+            {
+                nodes.push_back({subroutine, current_node, 0});
+                child = children.emplace(key, nodes.size() - 1).first;
+            }
+            current_node = child->second;
+        }
+        // A return at the top level (a stack underflow in the program) leaves the profile at the top level.
+        void leave_subroutine()
+        {
+            if (depth == 0)
+                return;
+            --depth;
+            current_node = nodes[current_node].parent;
+        }
+
+        void write_disassembly(Chip8 const& chip8, std::ostream& out) const;
+        void write_folded_stacks(std::ostream& out) const;
+};
@@ -0,0 +1,139 @@
+#include <iostream>
+#include <climits>
+#include <errno.h>
+#include <new>
+#include <signal.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "shared_display.hpp"
+
+Shared_display_writer::~Shared_display_writer()
+{
+	end_shared_display();
+}
+
+static_assert(sizeof(std::atomic<u32>) == sizeof(u32), "frame_signal has to be a plain 32-bit word to be used as a futex.");
+
+/*	Creates the POSIX shared memory object /dev/shm/<shm_name> and maps it. Readers open the same name read-only.
+	An existing object of that name is only replaced if it was left behind by a writer that has exited; otherwise this fails.
+	With signal_frames, readers waiting on frame_signal are woken once for each published frame.	*/
+bool Shared_display_writer::begin_shared_display(char const* shm_name, bool signal_frames)
+{
+	snprintf(name, sizeof(name), "/%s", shm_name[0] == '/' ? shm_name + 1 : shm_name);
+
+	shm_fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0644);
+	if (shm_fd < 0 && errno == EEXIST && remove_if_stale())
+		shm_fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0644);
+	if (shm_fd < 0 && errno == EEXIST)
+	{
+		cout << "Shared memory " << name << " already exists and is not a stale chip8 display, so it has been left alone.\n";
+		return false;
+	}
+	if (shm_fd < 0 || ftruncate(shm_fd, sizeof(Shared_display)) != 0)
+	{
+		cout << "Couldn't create shared memory " << name << ".\n";
+		end_shared_display();
+		return false;
+	}
+
+	void* mapping = mmap(nullptr, sizeof(Shared_display), PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
+	if (mapping == MAP_FAILED)
+	{
+		cout << "Couldn't map shared memory " << name << ".\n";
+		end_shared_display();
+		return false;
+	}
+
+	this->signal_frames = signal_frames;
+	region = new (mapping) Shared_display {};
+	region->width = X_RESOLUTION;
+	region->height = Y_RESOLUTION;
+	region->writer_pid = getpid();
+	region->signals_frames = signal_frames;
+	region->version = SHARED_DISPLAY_VERSION;
+	std::atomic_thread_fence(std::memory_order_release);
+	region->magic = SHARED_DISPLAY_MAGIC; // Written last so a reader that sees the magic sees a fully set up header.
+
+	cout << "Sharing display in /dev/shm" << name << ".\n";
+	return true;
+}
+
+/*	Unlinks the shared memory object at name if it has a chip8 display header whose writer is no longer running, as is
+	left behind when the emulator is killed. Anything else, including a display another emulator is still writing, is kept.	*/
+bool Shared_display_writer::remove_if_stale()
+{
+	int fd = shm_open(name, O_RDONLY | O_CLOEXEC, 0);
+	if (fd < 0)
+		return false;
+
+	Shared_display header;
+	size_t header_size = offsetof(Shared_display, sequence);
+	bool stale = pread(fd, &header, header_size, 0) == (ssize_t)header_size && header.magic == SHARED_DISPLAY_MAGIC
+	             && header.writer_pid > 0 && kill(header.writer_pid, 0) != 0 && errno == ESRCH;
+	close(fd);
+
+	if (stale && shm_unlink(name) == 0)
+	{
+		cout << "Removed stale shared memory " << name << " left by process " << header.writer_pid << ".\n";
+		return true;
+	}
+	return false;
+}
+
+void Shared_display_writer::end_shared_display()
+{
+	if (region)
+	{
+		munmap(region, sizeof(Shared_display));
+		region = nullptr;
+	}
+	if (shm_fd >= 0)
+	{
+		close(shm_fd);
+		shm_unlink(name);
+		shm_fd = -1;
+	}
+}
+
+/*	Writes the current frame and key state between the two seqlock increments. Only the rows that changed since the last frame
+	have their byte-per-pixel form rewritten.	*/
+void Shared_display_writer::publish(Chip8 const& chip8)
+{
+	if (!region)
+		return;
+
+	u64 rows[Y_RESOLUTION];
+	chip8.pack_display(rows);
+
+	u64 sequence = region->sequence.load(std::memory_order_relaxed);
+	region->sequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	for (unsigned int y = 0; y < Y_RESOLUTION; ++y)
+	{
+		if (rows[y] == last_rows[y])
+			continue;
+
+		region->rows[y] = rows[y];
+		for (unsigned int x = 0; x < X_RESOLUTION; ++x)
+			region->pixels[y * X_RESOLUTION + x] = (rows[y] >> (X_RESOLUTION - 1 - x)) & 1;
+		last_rows[y] = rows[y];
+	}
+	memcpy(region->keys, chip8.keyboard_controls, KEY_COUNT);
+
+	region->sequence.store(sequence + 2, std::memory_order_release);
+
+	if (signal_frames)
+	{
+		region->frame_signal.store((u32)((sequence + 2) / 2), std::memory_order_release);
+		syscall(SYS_futex, (u32*)&region->frame_signal, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+	}
+}
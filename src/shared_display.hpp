@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+
+#include "chip8.hpp"
+
+const u32 SHARED_DISPLAY_MAGIC = 0x38504843; // "CHP8"
+const u32 SHARED_DISPLAY_VERSION = 2;
+
+/*	Layout of the shared memory region. Readers map it read-only and read it in place; nothing is copied for them and
+	publishing a frame makes no system calls unless frame signals are on.
+
+	The frame is guarded by a seqlock. To read a consistent frame:
+		1. s1 = sequence (acquire). If s1 is odd a frame is being written, so try again.
+		2. Read whatever is needed from rows, pixels and keys.
+		3. Fence (acquire), then s2 = sequence. If s2 != s1 the frame changed while it was read, so try again.
+	frame_count is s1 / 2.
+
+	If signals_frames is 1, frame_signal is set to the low 32 bits of frame_count after each frame and every process waiting
+	on it is woken. To sleep until the frame after frame n, a reader calls
+		syscall(SYS_futex, &frame_signal, FUTEX_WAIT, (u32)n, timeout, nullptr, 0)
+	which returns at once if a newer frame is already there. It has to be the shared FUTEX_WAIT, not FUTEX_WAIT_PRIVATE.
+	This works on the read-only mapping and needs nothing from the writer's process, so unrelated readers can use it.	*/
+struct Shared_display
+{
+    u32 magic;
+    u32 version;
+    u32 width;
+    u32 height;
+    int32_t writer_pid;
+    u32 signals_frames;
+    alignas(64) std::atomic<u64> sequence;
+    std::atomic<u32> frame_signal;                  // A futex word, see above.
+    u64 rows[Y_RESOLUTION];                         // One bit per pixel, leftmost pixel in the most significant bit.
+    u8 pixels[X_RESOLUTION * Y_RESOLUTION];         // One byte per pixel, 0 or 1.
+    u8 keys[KEY_COUNT];                             // 1 while the key is held down.
+};
+
+class Shared_display_writer
+{
+    private:
+        Shared_display* region = nullptr;
+        int shm_fd = -1;
+        bool signal_frames = false;
+        char name[64] {};
+        u64 last_rows[Y_RESOLUTION] {};
+
+        bool remove_if_stale();
+
+    public:
+        Shared_display_writer() = default;
+        ~Shared_display_writer();
+        bool begin_shared_display(char const* shm_name, bool signal_frames);
+        void publish(Chip8 const& chip8);
+        void end_shared_display();
+};
@@ -0,0 +1,311 @@
+#include <algorithm>
+#include <iostream>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <poll.h>
+#include <unistd.h>
+
+#include "terminal_display.hpp"
+
+// The CHIP-8 key for each character, in the same layout as the window.
+static const char key_characters[KEY_COUNT + 1] = "x123qweasdzc4rfv";
+
+Terminal_display::~Terminal_display()
+{
+	end_display();
+}
+
+/*	Puts the terminal in to raw mode on the alternate screen, with the cursor hidden. Fails if stdin or stdout is not a terminal.	*/
+bool Terminal_display::begin_display(char const* title, bool use_braille)
+{
+	if (!isatty(STDIN_FILENO) || !isatty(STDOUT_FILENO))
+	{
+		cout << "The terminal display needs stdin and stdout to be a terminal.\n";
+		return false;
+	}
+	if (tcgetattr(STDIN_FILENO, &saved_settings) != 0)
+	{
+		cout << "Couldn't read the terminal settings.\n";
+		return false;
+	}
+
+	termios raw = saved_settings;
+	raw.c_lflag &= ~(ICANON | ECHO | ISIG | IEXTEN);
+	raw.c_iflag &= ~(IXON | ICRNL);
+	raw.c_cc[VMIN] = 0;
+	raw.c_cc[VTIME] = 0;
+	if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw) != 0)
+	{
+		cout << "Couldn't put the terminal in to raw mode.\n";
+		return false;
+	}
+
+	cout.flush();
+	started = true;
+	braille = use_braille;
+	columns = braille ? X_RESOLUTION / 2 : X_RESOLUTION;
+	rows = braille ? Y_RESOLUTION / 4 : Y_RESOLUTION / 2;
+	std::fill_n(shown_cells, MAX_TERMINAL_CELLS, 0xFFFF);
+	frame_pending = true;
+
+	output = "\x1b[?1049h\x1b[?25l\x1b[2J";
+	char status[320];
+	snprintf(status, sizeof(status), "\x1b[%d;1H%.200s  (Esc to quit)", rows + 2, title);
+	output += status;
+	write_output();
+	write_status();
+	return true;
+}
+
+void Terminal_display::end_display()
+{
+	if (!started)
+		return;
+	output = "\x1b[?25h\x1b[?1049l";
+	write_output();
+	tcsetattr(STDIN_FILENO, TCSAFLUSH, &saved_settings);
+	started = false;
+}
+
+/*	The pixels covered by one cell as a bit pattern: top then bottom pixel for half blocks, or the braille dot numbering
+	(dots 1 to 8 as bits 0 to 7) for braille.	*/
+u16 Terminal_display::cell_pattern(u64 const* frame, int column, int row) const
+{
+	auto pixel = [&](int x, int y) { return (u16)((frame[y] >> (X_RESOLUTION - 1 - x)) & 1); };
+
+	if (!braille)
+		return pixel(column, row * 2) | (pixel(column, row * 2 + 1) << 1);
+
+	static const u8 dot_bits[4][2] = {{0x01, 0x08}, {0x02, 0x10}, {0x04, 0x20}, {0x40, 0x80}};
+	u16 pattern = 0;
+	for (int y = 0; y < 4; ++y)
+		for (int x = 0; x < 2; ++x)
+			if (pixel(column * 2 + x, row * 4 + y))
+				pattern |= dot_bits[y][x];
+	return pattern;
+}
+
+void Terminal_display::append_glyph(u16 pattern)
+{
+	if (!braille)
+	{
+		static const char* half_blocks[4] = {" ", "▀", "▄", "█"};
+		output += half_blocks[pattern];
+		return;
+	}
+	// U+2800 + pattern, as three bytes of UTF-8.
+	u16 code_point = 0x2800 + pattern;
+	output += (char)(0xE0 | (code_point >> 12));
+	output += (char)(0x80 | ((code_point >> 6) & 0x3F));
+	output += (char)(0x80 | (code_point & 0x3F));
+}
+
+/*	Notes whether the display changed, and redraws the changed cells if the last redraw was long enough ago.
+	A change that arrives between redraws is drawn at the next one, so the last frame before the display stops changing is never lost.	*/
+void Terminal_display::update_display(Chip8 const& chip8, u32 now_ms)
+{
+	if (!started)
+		return;
+
+	u64 frame[Y_RESOLUTION];
+	chip8.pack_display(frame);
+	if (memcmp(frame, last_frame, sizeof(frame)) != 0)
+	{
+		memcpy(last_frame, frame, sizeof(frame));
+		frame_pending = true;
+	}
+	if (!frame_pending || now_ms - last_redraw_ms < TERMINAL_REFRESH_INTERVAL_MS)
+		return;
+
+	output.clear();
+	for (int row = 0; row < rows; ++row)
+	{
+		bool cursor_in_place = false;
+		for (int column = 0; column < columns; ++column)
+		{
+			u16 pattern = cell_pattern(last_frame, column, row);
+			u16& shown = shown_cells[row * columns + column];
+			if (pattern == shown)
+			{
+				cursor_in_place = false;
+				continue;
+			}
+			if (!cursor_in_place)
+			{
+				char move[32];
+				snprintf(move, sizeof(move), "\x1b[%d;%dH", row + 1, column + 1);
+				output += move;
+				cursor_in_place = true;
+			}
+			append_glyph(pattern);
+			shown = pattern;
+		}
+	}
+	write_output();
+	frame_pending = false;
+	last_redraw_ms = now_ms;
+}
+
+/*	Reads every byte waiting on stdin without blocking. A key is pressed when its character arrives and released once it has not
+	been seen for TERMINAL_KEY_HOLD_MS, which covers the gap before the terminal's key repeat starts. Escape sequences (arrow keys
+	and the like) can be split across reads, so they are kept in escape_pending until they are complete, then skipped or given to
+	run_escape_sequence(). An Escape quits once TERMINAL_ESCAPE_TIMEOUT_MS has passed with nothing after it, or when another
+	Escape follows it.	*/
+bool Terminal_display::get_key_press(u8* keys, u32 now_ms)
+{
+	if (!started)
+		return false;
+
+	bool quit = false;
+	pollfd input {STDIN_FILENO, POLLIN, 0};
+	while (poll(&input, 1, 0) > 0 && (input.revents & POLLIN))
+	{
+		char buffer[64];
+		ssize_t received = read(STDIN_FILENO, buffer, sizeof(buffer));
+		if (received <= 0)
+			break;
+
+		for (ssize_t i = 0; i < received; ++i)
+		{
+			char character = buffer[i];
+			if (character == 0x03)
+				quit = true;
+			if (character == 0x1B)
+			{
+				if (escape_pending.size() == 1)
+					quit = true;
+				escape_pending = character;
+				escape_started_ms = now_ms;
+				continue;
+			}
+			if (!escape_pending.empty())
+			{
+				escape_pending += character;
+				if (escape_sequence_complete())
+				{
+					run_escape_sequence(escape_pending);
+					escape_pending.clear();
+				}
+				continue;
+			}
+			if (character >= 'A' && character <= 'Z')
+				character += 'a' - 'A';
+
+			char const* key = strchr(key_characters, character);
+			if (character && key)
+			{
+				keys[key - key_characters] = 1;
+				held[key - key_characters] = true;
+				key_seen_ms[key - key_characters] = now_ms;
+			}
+		}
+	}
+
+	// A sequence that never finishes (e.g. a terminal that sends only part of one) is dropped after the same wait.
+	if (!escape_pending.empty() && now_ms - escape_started_ms >= TERMINAL_ESCAPE_TIMEOUT_MS)
+	{
+		if (escape_pending.size() == 1)
+			quit = true;
+		escape_pending.clear();
+	}
+
+	// Only keys pressed here are released here, so keys held through the frame stream are left alone.
+	for (unsigned int key = 0; key < KEY_COUNT; ++key)
+	{
+		if (held[key] && now_ms - key_seen_ms[key] > TERMINAL_KEY_HOLD_MS)
+		{
+			keys[key] = 0;
+			held[key] = false;
+		}
+	}
+	return quit;
+}
+
+/*	Whether escape_pending holds a whole sequence: ESC [ <parameters> <final byte> (CSI), ESC O <key>, or ESC <key> as sent with
+	Alt. A CSI sequence broken by a control character, or one longer than any key sends, is ended there so it is not kept.	*/
+bool Terminal_display::escape_sequence_complete() const
+{
+	if (escape_pending.size() < 2)
+		return false;
+	char introducer = escape_pending[1];
+	if (introducer != '[' && introducer != 'O')
+		return true;
+	if (escape_pending.size() < 3)
+		return false;
+	if (introducer == 'O')
+		return true;
+
+	char last = escape_pending.back();
+	return last < 0x20 || last >= 0x40 || escape_pending.size() >= MAX_ESCAPE_SEQUENCE_LENGTH;
+}
+
+/*	Acts on a complete escape sequence; everything but the debugger's function keys is skipped. Function keys arrive as
+	ESC [ <number> ~, and the ones the window uses for the debugger are handled the same way here. Terminals do not say whether
+	a key is repeating, so holding F5 toggles pause again with each repeat.	*/
+void Terminal_display::run_escape_sequence(std::string const& sequence)
+{
+	if (!debugger || sequence[1] != '[' || sequence.back() != '~')
+		return;
+
+	int number = 0;
+	for (size_t i = 2; i + 1 < sequence.size(); ++i)
+		if (sequence[i] >= '0' && sequence[i] <= '9')
+			number = number * 10 + sequence[i] - '0';
+
+	switch (number)
+	{
+		case 15: // F5
+			if (debugger->is_paused())
+				debugger->resume();
+			else
+				debugger->pause();
+			break;
+		case 20: // F9
+			debugger->toggle_breakpoint_at_pc();
+			break;
+		case 21: // F10
+			debugger->step_over();
+			break;
+		case 23: // F11
+			debugger->step_into(1);
+			break;
+	}
+}
+
+/*	Shows line under the display in place of the last one. It is kept if the display has not started yet, and drawn when it does.	*/
+void Terminal_display::show_status(std::string const& line)
+{
+	status = line;
+	write_status();
+}
+
+void Terminal_display::write_status()
+{
+	if (!started || status.empty())
+		return;
+
+	char move[32];
+	snprintf(move, sizeof(move), "\x1b[%d;1H\x1b[2K", rows + 3);
+	output = move;
+	for (char character : status)
+		if (character >= ' ' && output.size() < 200)
+			output += character;
+	write_output();
+}
+
+/*	Writes the whole of output, retrying on short writes. Terminal output is small, so this does not hold up the frame for long.	*/
+void Terminal_display::write_output()
+{
+	size_t written = 0;
+	while (written < output.size())
+	{
+		ssize_t result = write(STDOUT_FILENO, output.data() + written, output.size() - written);
+		if (result < 0 && errno != EINTR && errno != EAGAIN)
+			break;
+		if (result > 0)
+			written += result;
+	}
+	output.clear();
+}
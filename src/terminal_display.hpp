@@ -0,0 +1,59 @@
+#pragma once
+
+#include <string>
+#include <termios.h>
+
+#include "chip8.hpp"
+#include "debugger.hpp"
+
+const u32 TERMINAL_REFRESH_INTERVAL_MS = 33; // The terminal is redrawn at most this often (about 30 times a second), however fast frames are run.
+const u32 TERMINAL_KEY_HOLD_MS = 150;        // Terminals only send key presses, so a key counts as held until it has not been seen for this long.
+const u32 TERMINAL_ESCAPE_TIMEOUT_MS = 50;    // An Escape with nothing after it for this long is the Escape key, not the start of a sequence.
+const unsigned int MAX_ESCAPE_SEQUENCE_LENGTH = 16;
+const unsigned int MAX_TERMINAL_CELLS = X_RESOLUTION * Y_RESOLUTION / 2;
+
+/*	Draws the display in a terminal, for when there is no window, e.g. over SSH. Each character cell covers 1x2 pixels with the
+	half block characters (64x16 cells), or 2x4 pixels with braille (32x8 cells). Only cells that changed since the last redraw
+	are sent, with a cursor move wherever the changed cells are not next to each other, so a frame costs a few bytes per changed
+	cell and nothing at all when the display is unchanged.
+
+	Keys are read from stdin in raw mode with the same layout as the window (1234/qwer/asdf/zxcv), and F5, F9, F10 and F11
+	drive the debugger as they do in the window. Escape or Ctrl-C quits. Nothing else may write to the terminal while the
+	display is up, so the debugger's reports are shown on a line under the display instead (see show_status()).	*/
+class Terminal_display
+{
+    private:
+        bool braille = false;
+        bool started = false;
+        termios saved_settings {};
+        int columns {};
+        int rows {};
+        u16 shown_cells[MAX_TERMINAL_CELLS] {}; // The pattern drawn in each cell, or 0xFFFF if it has to be redrawn.
+        u64 last_frame[Y_RESOLUTION] {};
+        bool frame_pending = false; // A frame has changed since the last redraw.
+        u32 last_redraw_ms {};
+        u32 key_seen_ms[KEY_COUNT] {};
+        bool held[KEY_COUNT] {};
+        std::string output;
+        std::string status; // The last line given to show_status().
+        std::string escape_pending; // An escape sequence that has not finished arriving, from its Escape on.
+        u32 escape_started_ms {};
+
+        u16 cell_pattern(u64 const* frame, int column, int row) const;
+        void append_glyph(u16 pattern);
+        void write_output();
+        void write_status();
+        bool escape_sequence_complete() const;
+        void run_escape_sequence(std::string const& sequence);
+
+    public:
+        Debugger* debugger = nullptr;
+
+        Terminal_display() = default;
+        ~Terminal_display();
+        bool begin_display(char const* title, bool use_braille);
+        void update_display(Chip8 const& chip8, u32 now_ms);
+        bool get_key_press(u8* keyboard_controls, u32 now_ms); // Returns true when the program should quit.
+        void show_status(std::string const& line);
+        void end_display();
+};
@@ -0,0 +1,50 @@
+#include <iostream>
+#include <string.h>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "unix_socket.hpp"
+
+using std::cout;
+
+int listen_on_unix_socket(char const* path, int backlog, char const* purpose)
+{
+	sockaddr_un address {};
+	if (strlen(path) >= sizeof(address.sun_path))
+	{
+		cout << "The " << purpose << " socket path is too long.\n";
+		return -1;
+	}
+
+	struct stat existing;
+	if (stat(path, &existing) == 0)
+	{
+		if (!S_ISSOCK(existing.st_mode))
+		{
+			cout << path << " already exists and is not a socket.\n";
+			return -1;
+		}
+		unlink(path);
+	}
+
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+	{
+		cout << "Couldn't create " << purpose << " socket.\n";
+		return -1;
+	}
+
+	address.sun_family = AF_UNIX;
+	strcpy(address.sun_path, path);
+
+	if (bind(fd, (sockaddr*)&address, sizeof(address)) != 0 || listen(fd, backlog) != 0)
+	{
+		cout << "Couldn't listen on " << path << ".\n";
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+/*	Creates a non-blocking listening Unix domain socket at path and returns it, or -1 after saying why it couldn't.
+	A stale socket left behind by an earlier run is replaced, but any other kind of file at path is left alone.
+	purpose names the socket in messages, e.g. "stream".	*/
+int listen_on_unix_socket(char const* path, int backlog, char const* purpose);